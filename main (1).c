@@ -5,6 +5,23 @@
 #include <string.h>     // preciso para manipulação de strings (strcpy, strcmp...)
 #include <math.h>       // preciso para funções matemáticas (pow, sin, cos, log...)
 #include <time.h>       // incluído caso queira timestamps/ids (opcional)
+#include <limits.h>     // preciso para INT_MIN/INT_MAX (operandos inteiros vindos de texto)
+#include <float.h>      // preciso para DBL_MAX/DBL_MIN/DBL_EPSILON (autoteste das somas)
+#include <stdint.h>     // preciso para inteiros de largura fixa (bits do double, superacumulador)
+#include <errno.h>      // preciso para checar EINTR/ETIMEDOUT nas esperas do escritor
+#include <fcntl.h>      // preciso para open (arquivo de histórico em modo append)
+#include <unistd.h>     // preciso para write, fsync e close
+#include <sys/stat.h>   // preciso para fstat (saber se o CSV ainda está vazio)
+#include <sys/mman.h>   // preciso para mmap/madvise (arrays binários lidos direto do arquivo)
+#include <pthread.h>    // preciso para a thread que grava o histórico em segundo plano
+#include <semaphore.h>  // preciso para acordar o escritor e avisar fim de flush
+#include <stdatomic.h>  // preciso para a fila sem lock (índices atômicos)
+#include <stdarg.h>     // preciso para va_list (saída do modo lote acumulada em buffer)
+#include <dirent.h>     // preciso para listar diretórios de entrada no modo lote
+#include <spawn.h>      // preciso para posix_spawn no benchmark de partida
+#include <sys/wait.h>   // preciso para waitpid no benchmark de partida
+
+extern char **environ;  // repassado aos processos filhos do benchmark
 
 /* Definições de constantes usadas no programa */
 // tamanho máximo do histórico que guardamos em memória
@@ -13,6 +30,31 @@
 #define MAX_LINE 256
 // limite seguro para calcular fatorial sem estourar em unsigned long long
 #define FACT_LIMIT 20
+// transforma o valor de uma macro em literal de string (mensagens montadas em tempo de compilação)
+#define STR_(x) #x
+#define STR(x) STR_(x)
+// arquivo onde o histórico é persistido (log só de append)
+#define HIST_ARQUIVO "historico.csv"
+// capacidade da fila entre o menu e o escritor (precisa ser potência de 2)
+#define FILA_CAP 1024
+// intervalo padrão entre fsyncs quando a política é "intervalo"
+#define FSYNC_INTERVALO_MS 1000
+// tamanho da base da recursão na soma pareada
+#define SOMA_BLOCO_PAREADA 128
+// quantos desvios ao quadrado o desvio-padrão acumula por vez (buffer na pilha)
+#define SOMA_BLOCO_DESVIO 256
+// limbs de 32 bits que cobrem todo double em unidades de 2^-1074, com folga para o vai-um
+#define SUPERACC_LIMBS 68
+// cada limb aguenta 2^30 somas de dígitos de 32 bits antes de arriscar estouro
+#define SUPERACC_MAX_PENDENTES ((int64_t)1 << 30)
+// elementos somados entre duas conferências do limite acima
+#define SUPERACC_LOTE ((size_t)1 << 16)
+// valores convertidos por bloco ao ler float32/CSV (o buffer fica na fonte, não no chamador)
+#define FONTE_BLOCO 65536
+// maior pedaço do mapa float64 entregue de uma vez (zero cópia, mas precisa caber em int)
+#define FONTE_BLOCO_MAPA ((size_t)1 << 24)
+// bytes lidos do CSV por chamada de read()
+#define FONTE_BUF_CSV (1 << 20)
 
 // Struct para armazenar cada operação no histórico
 typedef struct {
@@ -22,12 +64,202 @@ typedef struct {
     int id;            // id único incremental da operação
 } Operacao;
 
+// Como as estatísticas somam os elementos (CALC_SOMA, --soma ou opção 19 do menu)
+typedef enum {
+    SOMA_INGENUA,   // laço simples, a mesma ordem de sempre
+    SOMA_KAHAN,     // Kahan-Neumaier compensada (TwoSum sem desvio), 8 faixas em vetores
+    SOMA_PAREADA,   // soma pareada (recursiva), erro cresce com log n
+    SOMA_EXATA      // superacumulador: resultado exato, arredondado uma vez só
+} EstrategiaSoma;
+
+// 4 doubles num registrador vetorial (extensão do GCC/Clang; vira SSE2/AVX conforme o alvo)
+typedef double v4d __attribute__((vector_size(4 * sizeof(double))));
+
+// Acumulador que permite somar em blocos, qualquer que seja a estratégia
+typedef struct {
+    EstrategiaSoma estrategia;
+    double s[8], c[8];               // ingênua usa s[0]; Kahan usa as 8 faixas e compensações
+    double pilha[64];                // pareada: pilha[k] soma 2^k blocos
+    uint64_t n_blocos;               // pareada: bits ligados dizem quais níveis da pilha estão ocupados
+    int64_t limbs[SUPERACC_LIMBS];   // exata: dígitos de 32 bits (em int64 para adiar o vai-um)
+    int64_t pendentes;               // exata: somas desde a última normalização
+    double nao_finitos;              // exata: inf/nan somados à parte
+    int tem_nao_finito;
+} AcumSoma;
+
+// Formato de um arquivo de números
+typedef enum {
+    FONTE_F64,   // binário little-endian float64 (mmap, sem cópia)
+    FONTE_F32,   // binário little-endian float32 (mmap, convertido em blocos)
+    FONTE_CSV    // texto: números separados por vírgula, ponto e vírgula ou espaços
+} TipoFonte;
+
+// Arquivo de números lido bloco a bloco pelas estatísticas
+typedef struct {
+    TipoFonte tipo;
+    int fd;
+    void *mapa;          // binários: arquivo inteiro mapeado, só leitura
+    size_t bytes;        // tamanho do mapeamento
+    size_t n;            // binários: quantos valores o arquivo tem
+    size_t pos;          // binários: próximo valor a entregar
+    int sem_copia;       // 1 se os blocos apontam direto pro mapa (float64 em host little-endian)
+    char *buf;           // CSV: buffer de leitura
+    size_t buf_ini, buf_fim;
+    int fim_arquivo;     // CSV: read() já devolveu 0
+    double *bloco;       // valores convertidos (float32, CSV ou host big-endian)
+} FonteNumeros;
+
+// Versão de uma estatística que consome um arquivo em vez de um array (n = valores lidos).
+// erro com n == 0: nada lido; erro com n > 0: faltou memória para os n valores
+typedef double (*FuncaoFonte)(FonteNumeros *f, size_t *n, int *erro);
+
+// Quando o escritor chama fsync depois de gravar (configurável via CALC_FSYNC)
+typedef enum {
+    FSYNC_NUNCA,      // só write; o SO decide quando vai pro disco (igual ao fclose antigo)
+    FSYNC_POR_LOTE,   // fsync depois de cada lote gravado (group commit)
+    FSYNC_INTERVALO   // no máximo um fsync a cada CALC_FSYNC_MS milissegundos
+} PoliticaFsync;
+
+// Fila circular sem lock, um produtor (thread do menu) e um consumidor (escritor)
+typedef struct {
+    Operacao itens[FILA_CAP];
+    atomic_size_t cabeca;   // próxima posição a consumir (só o escritor avança)
+    atomic_size_t cauda;    // próxima posição livre (só o produtor avança)
+} FilaOperacoes;
+
+// Estado da persistência assíncrona: fila, thread escritora e sinalização
+typedef struct {
+    FilaOperacoes fila;
+    pthread_t thread;
+    sem_t sinal;              // acorda o escritor (chegou operação, flush ou fim)
+    sem_t flush_ok;           // devolve o controle pra quem pediu flush
+    atomic_int pedidos_flush; // quantos flushes estão esperando resposta
+    atomic_int encerrar;      // 1 quando o programa está saindo
+    int fd;                   // descritor do CSV aberto em O_APPEND
+    char *buf;                // texto de um lote inteiro (alocado antes de subir o escritor)
+    size_t buf_cap;
+    PoliticaFsync politica;
+    int intervalo_ms;
+    int ativo;                // 0 se não deu pra abrir o arquivo ou alocar o buffer
+} Persistencia;
+
+// Histórico em memória + escritor; só é carregado/iniciado na primeira vez que alguém precisa
+typedef struct {
+    Operacao itens[MAX_HIST];
+    int count;            // quantas operações temos no histórico
+    int proximo_id;       // id incremental para atribuir às operações
+    int carregado;        // 0 até o primeiro uso (partida não lê o CSV)
+    Persistencia persist; // escritor em segundo plano do historico.csv
+} Historico;
+
+// Operações de array aceitam qualquer quantidade de operandos (>= 1)
+#define ARIDADE_ARRAY (-1)
+// Operações de matriz 2x2 recebem A e B por linha: 8 operandos
+#define ARIDADE_MATRIZ 8
+
+// Como uma operação trata falhas matemáticas
+typedef enum {
+    ERRO_NUNCA,     // sempre produz resultado
+    ERRO_SINALIZA   // pode falhar: mostra msg_erro e grava NAN no histórico
+} SemanticaErro;
+
+// Assinatura comum de todas as operações do registro (v tem n operandos)
+typedef double (*FuncaoOp)(double v[], int n, int *erro);
+
+// Operações de matriz: o resultado é outra matriz 2x2, não cabe no double de FuncaoOp
+typedef void (*FuncaoMatriz)(double A[2][2], double B[2][2], double R[2][2]);
+
+// Índices fixos do registro (o menu e o código referenciam por eles)
+enum {
+    OP_SOMA, OP_SUBTRACAO, OP_MULTIPLICACAO, OP_DIVISAO, OP_POTENCIA, OP_RAIZ, OP_FATORIAL,
+    OP_MEDIA, OP_MEDIANA, OP_DESVIO, OP_MAXIMO, OP_MINIMO, OP_MDC, OP_MMC, OP_LOG,
+    OP_SIN, OP_COS, OP_TAN, OP_G2R, OP_R2G, OP_MAT_SOMA, OP_MAT_MUL,
+    N_OPERACOES
+};
+
+// Descritor de uma operação: tudo que menu, lote e CLI precisam saber sobre ela
+typedef struct {
+    const char *nome;         // nome no histórico, no lote e na CLI (ex: "SOMA")
+    int aridade;              // 1, 2, ARIDADE_ARRAY ou ARIDADE_MATRIZ
+    FuncaoOp fn;              // NULL nas matrizes (usam fn_matriz)
+    SemanticaErro erros;
+    const char *msg_erro;     // mensagem quando erros == ERRO_SINALIZA e a conta falha
+    const char *rotulo;       // como o resultado aparece no menu ("Media = ...")
+    const char *prompts[2];   // perguntas do menu para cada operando (aridade 1 ou 2)
+    int inteiro;              // operandos lidos como inteiros e resultado sem casas decimais
+    FuncaoFonte fn_fonte;     // arrays: mesma conta lendo de arquivo (NULL se não se aplica)
+    FuncaoMatriz fn_matriz;   // matrizes 2x2: R = f(A, B) (NULL nas outras)
+} DescritorOp;
+
+// Como um item do menu usa as operações que aponta
+typedef enum {
+    MENU_UMA,      // uma operação só
+    MENU_TODAS,    // mesmos operandos, todas as operações (ex: máximo e mínimo)
+    MENU_ESCOLHA   // submenu: o usuário escolhe uma delas
+} TipoItemMenu;
+
+// Item do menu principal
+typedef struct {
+    const char *titulo;
+    TipoItemMenu tipo;
+    int ops[3];               // índices no registro
+    int n_ops;
+    const char *rotulos[3];   // textos do submenu (MENU_ESCOLHA)
+} ItemMenu;
+
+// Buffer de texto que cresce conforme a saída de um arquivo do lote
+typedef struct {
+    char *dados;
+    size_t tam, cap;
+} TextoSaida;
+
+// Um arquivo de entrada do modo lote e o que foi produzido a partir dele
+typedef struct {
+    char *nome;         // caminho do arquivo
+    TextoSaida saida;   // resultados na ordem das linhas
+    int n_ops;          // quantas operações válidas ele tinha
+    double ms;          // tempo gasto processando o arquivo
+} ArquivoLote;
+
+// Operação do histórico local de um trabalhador, marcada com a origem pra mesclar na ordem
+typedef struct {
+    int arquivo;        // índice do arquivo de onde veio
+    int seq;            // posição da operação dentro do arquivo
+    Operacao op;
+} EntradaLote;
+
+struct Lote;
+
+// Trabalhador do pool: deque de arquivos + scratch e histórico próprios (nada compartilhado)
+typedef struct {
+    pthread_mutex_t trava;    // protege inicio/fim (o dono tira do início, ladrões do fim)
+    int inicio, fim;          // faixa [inicio, fim) de índices de arquivo ainda pendentes
+    int id;
+    int roubos;               // quantas tarefas pegou de outros trabalhadores
+    struct Lote *lote;
+    double *scratch;          // operandos da linha atual (reaproveitado entre linhas)
+    size_t scratch_cap;
+    char *linha;              // buffer do getline
+    size_t linha_cap;
+    EntradaLote hist[MAX_HIST]; // heap mínimo com as MAX_HIST operações mais recentes que ele viu
+    size_t hist_n;
+} TrabalhadorLote;
+
+// Estado compartilhado do modo lote
+typedef struct Lote {
+    ArquivoLote *arquivos;
+    int n_arquivos;
+    TrabalhadorLote *trab;
+    int n_trab;
+} Lote;
+
 /* Protótipos das funções organizadas por grupo */
 
 // Funções de entrada/saída
 int ler_inteiro(char *prompt);       // lê um inteiro do usuário com validação
 double ler_double(char *prompt);     // lê um double do usuário com validação
 void limpar_buffer();                // limpa buffer do stdin até '\n'
+void ler_linha(char *prompt, char *buf, size_t cap); // lê uma linha de texto (sem o '\n')
 void pausar();                       // pausa e espera ENTER para continuar
 
 // Funções de cálculo (muitas implementadas)
@@ -40,6 +272,7 @@ double raiz(double a, double b, int *erro);            // raiz b-ésima de a, co
 unsigned long long fatorial(int n, int *erro);         // fatorial (inteiro) com limite
 double media(double arr[], int n);                     // média aritmética de um array
 double mediana(double arr[], int n);                   // mediana de um array
+double mediana_no_lugar(double v[], size_t n);         // mediana reordenando v (seleção, sem ordenar tudo)
 double desvio_padrao(double arr[], int n);             // desvio padrão populacional
 double maximo(double arr[], int n);                    // máximo do array
 double minimo(double arr[], int n);                    // mínimo do array
@@ -49,6 +282,29 @@ double meu_log(double a, int *erro);                   // log natural com verifi
 double graus_para_radianos(double g);                  // converte graus -> rad
 double radianos_para_graus(double r);                  // converte rad -> graus
 
+// Estratégias de soma
+int definir_estrategia_soma(const char *nome);                         // escolhe pelo nome, 0 se não existe
+const char *nome_estrategia_soma(EstrategiaSoma e);                    // nome para exibir
+void acum_iniciar(AcumSoma *a, EstrategiaSoma e);                      // zera o acumulador
+void acum_adicionar(AcumSoma *a, const double *v, size_t n);           // soma mais um bloco
+double acum_resultado(AcumSoma *a);                                    // resultado final
+double somar_com(EstrategiaSoma e, const double *v, size_t n);         // soma com estratégia explícita
+double somar(const double *v, size_t n);                               // soma com a estratégia atual
+void acum_desvios_quadrados(AcumSoma *a, const double *v, size_t n, double m); // soma (v[i]-m)^2
+
+// Arquivos de números (mmap para binários, leitura em blocos para CSV)
+int tipo_fonte_por_nome(const char *nome);                             // "f64", "f32", "csv" ou -1
+int abrir_fonte(FonteNumeros *f, const char *caminho, TipoFonte tipo); // abre/mapeia, 0 se falhou
+void fechar_fonte(FonteNumeros *f);                                    // desmapeia e libera
+int fonte_reiniciar(FonteNumeros *f);                                  // volta ao primeiro valor
+size_t fonte_proximo_bloco(FonteNumeros *f, double **v);               // próximo bloco (0 = fim)
+size_t fonte_ler(FonteNumeros *f, double *saida, size_t quantos);      // copia os primeiros valores
+double fonte_media(FonteNumeros *f, size_t *n, int *erro);
+double fonte_mediana(FonteNumeros *f, size_t *n, int *erro);
+double fonte_desvio(FonteNumeros *f, size_t *n, int *erro);
+double fonte_maximo(FonteNumeros *f, size_t *n, int *erro);
+double fonte_minimo(FonteNumeros *f, size_t *n, int *erro);
+
 // Funções trigonométricas encapsuladas
 double trig_sin(double x);
 double trig_cos(double x);
@@ -61,8 +317,30 @@ void multiplica_matriz_2x2(double A[2][2], double B[2][2], double R[2][2]); // p
 // Histórico e persistência
 void adicionar_historico(Operacao hist[], int *count, Operacao op);   // adiciona operação ao histórico
 void listar_historico(Operacao hist[], int count);                    // imprime o histórico
-void salvar_historico_csv(Operacao hist[], int count, const char *nome_arquivo); // salva em CSV
 int carregar_historico_csv(Operacao hist[], int *count, const char *nome_arquivo); // carrega CSV
+int compactar_historico_csv(Operacao hist[], int count, const char *nome_arquivo, int sincronizar); // reescreve só o que está em memória
+
+// Persistência assíncrona (thread escritora com group commit)
+int iniciar_persistencia(Persistencia *p, const char *nome_arquivo);  // abre o CSV e sobe o escritor
+void enfileirar_operacao(Persistencia *p, Operacao op);              // entrega op ao escritor sem bloquear em disco
+void sincronizar_persistencia(Persistencia *p);                      // espera tudo que foi enfileirado ser gravado
+void encerrar_persistencia(Persistencia *p);                         // flush final e join do escritor
+void registrar_operacao(Operacao hist[], int *count, Persistencia *p, Operacao op); // memória + disco
+Historico *historico_pronto(Historico *h);                           // carrega o CSV no primeiro uso
+void historico_registrar(Historico *h, Operacao op);                 // atribui id e registra
+int historico_encerrar(Historico *h);                                // flush final e compactação (se foi usado)
+
+// Registro estático de operações
+const DescritorOp *buscar_operacao(const char *nome);                 // descritor pelo nome ou NULL
+void calcular_matriz(const DescritorOp *d, const double v[], double R[2][2]); // R a partir dos 8 operandos
+int aridade_aceita(const DescritorOp *d, int n);                      // n operandos servem?
+int operandos_inteiros_ok(const DescritorOp *d, const double v[], int n); // inteiros dentro de int, se d->inteiro
+void formatar_resultado(const DescritorOp *d, double res, char *buf, size_t cap); // texto do resultado
+Operacao preencher_operacao(const DescritorOp *d, const double v[], int n, double res, int erro); // registro do histórico
+int operacao_falhou(const DescritorOp *d, int erro);                  // aplica a semântica de erro do descritor
+
+// Modo lote (vários arquivos em paralelo)
+int executar_lote(char **caminhos, int n_caminhos, int n_threads, Historico *h); // roda e mescla histórico
 
 // Auxiliares para matrizes
 void imprimir_matriz_2x2(double M[2][2]);                              // exibe matriz 2x2 formatada
@@ -122,6 +400,19 @@ double ler_double(char *prompt) {
     }
 }
 
+// ler_linha: lê uma linha de texto (ex: caminho de arquivo) e tira o '\n' do final
+void ler_linha(char *prompt, char *buf, size_t cap) {
+    while (1) {
+        printf("%s", prompt);
+        if (!fgets(buf, (int)cap, stdin)) {
+            clearerr(stdin);
+            continue;
+        }
+        buf[strcspn(buf, "\r\n")] = '\0';
+        return;
+    }
+}
+
 /* Funções matemáticas básicas */
 
 // soma: retorna a + b
@@ -177,33 +468,276 @@ unsigned long long fatorial(int n, int *erro) {
     return res;
 }
 
-// media: soma todos os elementos e divide por n (protege n <= 0)
+/* Estratégias de soma usadas pelas estatísticas (média e desvio-padrão) */
+
+// estrategia_soma: escolhida uma vez (CALC_SOMA, --soma ou opção 19) antes de qualquer cálculo
+static EstrategiaSoma estrategia_soma = SOMA_INGENUA;
+
+static const char *NOMES_SOMA[] = {"ingenua", "kahan", "pareada", "exata"};
+
+// definir_estrategia_soma: troca a estratégia pelo nome; retorna 0 se o nome não existe
+int definir_estrategia_soma(const char *nome) {
+    for (int i = 0; i < 4; ++i) {
+        if (strcmp(nome, NOMES_SOMA[i]) == 0) {
+            estrategia_soma = (EstrategiaSoma)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// nome_estrategia_soma: nome da estratégia (para menus e benchmark)
+const char *nome_estrategia_soma(EstrategiaSoma e) { return NOMES_SOMA[e]; }
+
+// duas_somas: um passo de Kahan-Neumaier com o TwoSum de Knuth: o erro exato de s + x vai
+// para *c sem comparar magnitudes, então não há desvio e a mesma conta serve para vetores
+static inline void duas_somas(double *s, double *c, double x) {
+    double t = *s + x;
+    double z = t - *s;
+    *c += (*s - (t - z)) + (x - z);
+    *s = t;
+}
+
+// duas_somas_v4: o mesmo passo em 4 faixas de uma vez
+static inline void duas_somas_v4(v4d *s, v4d *c, const v4d *x) {
+    v4d t = *s + *x;
+    v4d z = t - *s;
+    *c += (*s - (t - z)) + (*x - z);
+    *s = t;
+}
+
+// soma_pareada: recursão pela metade; a base soma 8 faixas independentes (ILP/SIMD)
+static double soma_pareada(const double *v, size_t n) {
+    if (n <= SOMA_BLOCO_PAREADA) {
+        double f[8] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+            for (int k = 0; k < 8; ++k) f[k] += v[i + k];
+        double s = ((f[0] + f[1]) + (f[2] + f[3])) + ((f[4] + f[5]) + (f[6] + f[7]));
+        for (; i < n; ++i) s += v[i];
+        return s;
+    }
+    size_t meio = (n / 2) & ~(size_t)7; // divide em múltiplo de 8 pra base não ter sobra
+    return soma_pareada(v, meio) + soma_pareada(v + meio, n - meio);
+}
+
+// superacc_normalizar: propaga os "vai-um" para cada limb ficar em [0, 2^32) (o último guarda o sinal)
+static void superacc_normalizar(AcumSoma *a) {
+    for (int i = 0; i < SUPERACC_LIMBS - 1; ++i) {
+        int64_t vai = a->limbs[i] >> 32; // deslocamento aritmético: arredonda pra baixo também nos negativos
+        a->limbs[i] -= vai * ((int64_t)1 << 32);
+        a->limbs[i + 1] += vai;
+    }
+    a->pendentes = 0;
+}
+
+// superacc_adicionar: soma x exatamente, como inteiro em unidades de 2^-1074 (o menor subnormal)
+static inline void superacc_adicionar(AcumSoma *a, double x) {
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int exp = (int)((bits >> 52) & 0x7ff);
+    uint64_t mant = bits & (((uint64_t)1 << 52) - 1);
+    if (exp == 0x7ff) { a->nao_finitos += x; a->tem_nao_finito = 1; return; }
+    if (exp == 0) exp = 1;                // subnormal: mesmo expoente do menor normal, sem bit implícito
+    else mant |= (uint64_t)1 << 52;
+    int pos = exp - 1;                    // posição do bit 0 da mantissa
+    int k = pos >> 5, s = pos & 31;
+    // mantissa de 53 bits deslocada s bits, quebrada em três dígitos de 32 bits
+    int64_t d0 = (int64_t)((mant << s) & 0xffffffffu);
+    int64_t d1 = (int64_t)((s ? mant >> (32 - s) : mant >> 32) & 0xffffffffu);
+    int64_t d2 = (int64_t)(s ? mant >> (64 - s) : 0);
+    if (bits >> 63) { d0 = -d0; d1 = -d1; d2 = -d2; }
+    a->limbs[k] += d0;
+    a->limbs[k + 1] += d1;
+    a->limbs[k + 2] += d2;
+}
+
+// superacc_resultado: arredonda o inteiro gigante para o double mais próximo (empate vai pro par)
+static double superacc_resultado(AcumSoma *a) {
+    if (a->tem_nao_finito) return a->nao_finitos;
+    superacc_normalizar(a);
+    int negativo = a->limbs[SUPERACC_LIMBS - 1] < 0;
+    if (negativo) {
+        for (int i = 0; i < SUPERACC_LIMBS; ++i) a->limbs[i] = -a->limbs[i];
+        superacc_normalizar(a);
+    }
+    int h = SUPERACC_LIMBS - 1;
+    while (h >= 0 && a->limbs[h] == 0) --h;
+    if (h < 0) return 0.0;
+
+    uint64_t alto = (uint64_t)a->limbs[h];
+    uint64_t meio = h >= 1 ? (uint64_t)a->limbs[h - 1] : 0;
+    uint64_t baixo = h >= 2 ? (uint64_t)a->limbs[h - 2] : 0;
+    int nb = 64 - __builtin_clzll(alto);  // bits usados no limb mais alto (1..32)
+    // os 64 bits mais significativos, com o bit 63 ligado
+    uint64_t m = (alto << (64 - nb)) | (meio << (32 - nb)) | (baixo >> nb);
+    int resto = (baixo & (((uint64_t)1 << nb) - 1)) != 0; // sticky: algo abaixo dos 64 bits?
+    for (int i = h - 3; i >= 0 && !resto; --i) resto = a->limbs[i] != 0;
+
+    uint64_t fica = m >> 11, sobra = m & 0x7ff;
+    if (sobra > 0x400 || (sobra == 0x400 && (resto || (fica & 1)))) ++fica;
+    double r = ldexp((double)fica, 32 * h + nb - 64 - 1074 + 11);
+    return negativo ? -r : r;
+}
+
+// acum_iniciar: zera o acumulador para a estratégia pedida
+void acum_iniciar(AcumSoma *a, EstrategiaSoma e) {
+    memset(a, 0, sizeof(*a));
+    a->estrategia = e;
+}
+
+// acum_adicionar: soma um bloco de valores; pode ser chamado várias vezes (streaming)
+void acum_adicionar(AcumSoma *a, const double *v, size_t n) {
+    switch (a->estrategia) {
+        case SOMA_INGENUA:
+            for (size_t i = 0; i < n; ++i) a->s[0] += v[i];
+            break;
+
+        case SOMA_KAHAN: {
+            // 2 vetores de 4 faixas: duas cadeias independentes escondem a latência das somas
+            v4d s0, s1, c0, c1, x0, x1;
+            memcpy(&s0, a->s, sizeof(v4d));
+            memcpy(&s1, a->s + 4, sizeof(v4d));
+            memcpy(&c0, a->c, sizeof(v4d));
+            memcpy(&c1, a->c + 4, sizeof(v4d));
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                memcpy(&x0, v + i, sizeof(v4d)); // memcpy: v não precisa estar alinhado
+                memcpy(&x1, v + i + 4, sizeof(v4d));
+                duas_somas_v4(&s0, &c0, &x0);
+                duas_somas_v4(&s1, &c1, &x1);
+            }
+            memcpy(a->s, &s0, sizeof(v4d));
+            memcpy(a->s + 4, &s1, sizeof(v4d));
+            memcpy(a->c, &c0, sizeof(v4d));
+            memcpy(a->c + 4, &c1, sizeof(v4d));
+            for (; i < n; ++i) duas_somas(&a->s[0], &a->c[0], v[i]);
+            break;
+        }
+
+        case SOMA_PAREADA: {
+            // cada bloco vira uma soma pareada; os blocos se combinam como num contador binário
+            double x = soma_pareada(v, n);
+            int k = 0;
+            while (a->n_blocos & ((uint64_t)1 << k)) x += a->pilha[k++];
+            a->pilha[k] = x;
+            a->n_blocos++;
+            break;
+        }
+
+        case SOMA_EXATA:
+            // o limite de vai-um é conferido uma vez por lote, não a cada elemento
+            while (n > 0) {
+                size_t k = n < SUPERACC_LOTE ? n : SUPERACC_LOTE;
+                if (a->pendentes + (int64_t)k > SUPERACC_MAX_PENDENTES) superacc_normalizar(a);
+                for (size_t i = 0; i < k; ++i) superacc_adicionar(a, v[i]);
+                a->pendentes += (int64_t)k;
+                v += k;
+                n -= k;
+            }
+            break;
+    }
+}
+
+// acum_resultado: soma final (pode normalizar o superacumulador, por isso não é const)
+double acum_resultado(AcumSoma *a) {
+    switch (a->estrategia) {
+        case SOMA_KAHAN: {
+            double s = 0.0, c = 0.0, bruta = 0.0;
+            for (int k = 0; k < 8; ++k) bruta += a->s[k];
+            // com inf/nan na entrada o TwoSum gera nan nas compensações; a soma das faixas já é a resposta
+            if (!isfinite(bruta)) return bruta;
+            // as compensações também passam pelo TwoSum: somadas direto, um c grande
+            // de uma faixa engoliria o c pequeno de outra
+            for (int k = 0; k < 8; ++k) duas_somas(&s, &c, a->s[k]);
+            for (int k = 0; k < 8; ++k) duas_somas(&s, &c, a->c[k]);
+            return s + c;
+        }
+        case SOMA_PAREADA: {
+            double s = 0.0;
+            for (int k = 0; k < 64; ++k)
+                if (a->n_blocos & ((uint64_t)1 << k)) s += a->pilha[k];
+            return s;
+        }
+        case SOMA_EXATA:
+            return superacc_resultado(a);
+        default:
+            return a->s[0];
+    }
+}
+
+// somar_com: soma v[0..n-1] com a estratégia e
+double somar_com(EstrategiaSoma e, const double *v, size_t n) {
+    AcumSoma a;
+    acum_iniciar(&a, e);
+    acum_adicionar(&a, v, n);
+    return acum_resultado(&a);
+}
+
+// somar: soma v[0..n-1] com a estratégia escolhida pelo usuário
+double somar(const double *v, size_t n) { return somar_com(estrategia_soma, v, n); }
+
+// acum_desvios_quadrados: soma (v[i] - m)^2 passando por um buffer pequeno na pilha, bloco a bloco
+void acum_desvios_quadrados(AcumSoma *a, const double *v, size_t n, double m) {
+    double quad[SOMA_BLOCO_DESVIO];
+    for (size_t i = 0; i < n; i += SOMA_BLOCO_DESVIO) {
+        size_t k = n - i < SOMA_BLOCO_DESVIO ? n - i : SOMA_BLOCO_DESVIO;
+        for (size_t j = 0; j < k; ++j) {
+            double d = v[i + j] - m;
+            quad[j] = d * d;
+        }
+        acum_adicionar(a, quad, k);
+    }
+}
+
+// media: soma todos os elementos (com a estratégia escolhida) e divide por n (protege n <= 0)
 double media(double arr[], int n) {
     if (n <= 0) return 0.0;
-    double s = 0.0;
-    for (int i = 0; i < n; ++i) s += arr[i];
-    return s / (double)n;
+    return somar(arr, (size_t)n) / (double)n;
 }
 
-// função auxiliar de comparação usada pelo qsort para doubles
-int cmp_double(const void *p1, const void *p2) {
-    double a = *(double *)p1;
-    double b = *(double *)p2;
-    if (a < b) return -1;
-    if (a > b) return 1;
-    return 0;
+// selecionar_k: quickselect (Hoare, pivô mediana de 3); deixa v[k] no lugar que teria ordenado
+// e tudo antes dele <= v[k]. O(n) em média, contra O(n log n) do qsort
+static double selecionar_k(double v[], size_t n, size_t k) {
+    long long lo = 0, hi = (long long)n - 1, alvo = (long long)k;
+    while (lo < hi) {
+        long long meio = lo + (hi - lo) / 2;
+        double a = v[lo], b = v[meio], c = v[hi];
+        double piv = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+        long long i = lo, j = hi;
+        while (i <= j) {
+            while (v[i] < piv) ++i;
+            while (v[j] > piv) --j;
+            if (i <= j) {
+                double t = v[i]; v[i] = v[j]; v[j] = t;
+                ++i; --j;
+            }
+        }
+        if (alvo <= j) hi = j;
+        else if (alvo >= i) lo = i;
+        else break; // entre j e i tudo é igual ao pivô
+    }
+    return v[alvo];
+}
+
+// mediana_no_lugar: mediana reordenando o próprio v (sem cópia)
+double mediana_no_lugar(double v[], size_t n) {
+    if (n == 0) return 0.0;
+    double alto = selecionar_k(v, n, n / 2);
+    if (n % 2 == 1) return alto;
+    // com n par, o vizinho de baixo é o maior da metade esquerda
+    double baixo = v[0];
+    for (size_t i = 1; i < n / 2; ++i) if (v[i] > baixo) baixo = v[i];
+    return (baixo + alto) / 2.0;
 }
 
-// mediana: faz uma cópia do array, ordena e retorna a mediana (não altera o original)
+// mediana: faz uma cópia do array e seleciona nela a mediana (não altera o original)
 double mediana(double arr[], int n) {
     if (n <= 0) return 0.0;
     double *copia = malloc(sizeof(double) * n);
     if (!copia) return 0.0; // se não tem memória, retornamos 0
-    for (int i = 0; i < n; ++i) copia[i] = arr[i];
-    qsort(copia, n, sizeof(double), cmp_double);
-    double med;
-    if (n % 2 == 1) med = copia[n / 2];
-    else med = (copia[n / 2 - 1] + copia[n / 2]) / 2.0;
+    memcpy(copia, arr, sizeof(double) * n);
+    double med = mediana_no_lugar(copia, (size_t)n);
     free(copia);
     return med;
 }
@@ -212,12 +746,10 @@ double mediana(double arr[], int n) {
 double desvio_padrao(double arr[], int n) {
     if (n <= 0) return 0.0;
     double m = media(arr, n);
-    double soma = 0.0;
-    for (int i = 0; i < n; ++i) {
-        double d = arr[i] - m;
-        soma += d * d;
-    }
-    return sqrt(soma / (double)n);
+    AcumSoma acum;
+    acum_iniciar(&acum, estrategia_soma);
+    acum_desvios_quadrados(&acum, arr, (size_t)n, m);
+    return sqrt(acum_resultado(&acum) / (double)n);
 }
 
 // maximo: retorna o maior elemento do array (protege n <= 0)
@@ -322,6 +854,355 @@ void ler_matriz_2x2(double M[2][2], char *nome) {
     }
 }
 
+/* Entrada de arquivos: binário mapeado com mmap (sem cópia) e CSV lido em blocos grandes */
+
+// host_little_endian: os binários são little-endian; em host big-endian precisamos converter
+static int host_little_endian(void) {
+    uint16_t x = 1;
+    uint8_t b;
+    memcpy(&b, &x, 1);
+    return b == 1;
+}
+
+// tipo_fonte_por_nome: "--f64"/"f64", "--f32"/"f32", "--csv"/"csv"; -1 se não reconhece
+int tipo_fonte_por_nome(const char *nome) {
+    while (*nome == '-') ++nome;
+    if (strcmp(nome, "f64") == 0) return FONTE_F64;
+    if (strcmp(nome, "f32") == 0) return FONTE_F32;
+    if (strcmp(nome, "csv") == 0) return FONTE_CSV;
+    return -1;
+}
+
+// abrir_fonte: binários são mapeados inteiros, só para leitura (nada vira cópia privada);
+// CSV só abre o descritor e aloca o buffer de leitura
+int abrir_fonte(FonteNumeros *f, const char *caminho, TipoFonte tipo) {
+    memset(f, 0, sizeof(*f));
+    f->tipo = tipo;
+    f->fd = open(caminho, O_RDONLY);
+    if (f->fd < 0) return 0;
+
+    if (tipo == FONTE_CSV) {
+        f->buf = malloc(FONTE_BUF_CSV + 1); // +1 para o '\0' que limita o strtod
+        f->bloco = malloc(sizeof(double) * FONTE_BLOCO);
+        if (!f->buf || !f->bloco) { fechar_fonte(f); return 0; }
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(f->fd, &st) != 0) { fechar_fonte(f); return 0; }
+    size_t largura = tipo == FONTE_F64 ? sizeof(double) : sizeof(float);
+    f->n = (size_t)st.st_size / largura;
+    f->bytes = f->n * largura;
+    if (f->n == 0) return 1;
+    f->mapa = mmap(NULL, f->bytes, PROT_READ, MAP_PRIVATE, f->fd, 0);
+    if (f->mapa == MAP_FAILED) { f->mapa = NULL; fechar_fonte(f); return 0; }
+    madvise(f->mapa, f->bytes, MADV_SEQUENTIAL); // só uma dica: todas as leituras vão do começo ao fim
+    // float64 no mesmo formato do host é entregue direto do mapa; o resto passa por um bloco
+    f->sem_copia = tipo == FONTE_F64 && host_little_endian();
+    if (!f->sem_copia) {
+        f->bloco = malloc(sizeof(double) * FONTE_BLOCO);
+        if (!f->bloco) { fechar_fonte(f); return 0; }
+    }
+    return 1;
+}
+
+// fechar_fonte: desfaz o mapeamento e libera os buffers
+void fechar_fonte(FonteNumeros *f) {
+    if (f->mapa) munmap(f->mapa, f->bytes);
+    if (f->fd >= 0) close(f->fd);
+    free(f->buf);
+    free(f->bloco);
+    f->mapa = NULL;
+    f->buf = NULL;
+    f->bloco = NULL;
+    f->fd = -1;
+}
+
+// fonte_reiniciar: volta pro começo (o desvio-padrão faz duas passadas)
+int fonte_reiniciar(FonteNumeros *f) {
+    f->pos = 0;
+    if (f->tipo != FONTE_CSV) return 1;
+    f->buf_ini = f->buf_fim = 0;
+    f->fim_arquivo = 0;
+    return lseek(f->fd, 0, SEEK_SET) == 0;
+}
+
+// eh_separador_csv: o que separa números no CSV (vírgula, ponto e vírgula e espaços)
+static int eh_separador_csv(char c) {
+    return c == ',' || c == ';' || c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// csv_proximo_bloco: converte números do buffer até encher o bloco, lendo FONTE_BUF_CSV bytes por vez
+static size_t csv_proximo_bloco(FonteNumeros *f) {
+    size_t k = 0;
+    while (k < FONTE_BLOCO) {
+        // só analisamos até o último separador: um número cortado no fim do buffer espera a próxima leitura
+        size_t limite = f->buf_fim;
+        if (!f->fim_arquivo) {
+            while (limite > f->buf_ini && !eh_separador_csv(f->buf[limite - 1])) --limite;
+        }
+        if (limite == f->buf_ini) {
+            if (f->fim_arquivo) break;
+            // sobrou só um pedaço de número: puxamos pro começo e lemos mais
+            size_t resto = f->buf_fim - f->buf_ini;
+            if (resto == FONTE_BUF_CSV) { f->buf_ini = f->buf_fim; continue; } // token absurdo, descarta
+            memmove(f->buf, f->buf + f->buf_ini, resto);
+            f->buf_ini = 0;
+            f->buf_fim = resto;
+            ssize_t lidos;
+            do lidos = read(f->fd, f->buf + f->buf_fim, FONTE_BUF_CSV - f->buf_fim);
+            while (lidos < 0 && errno == EINTR);
+            if (lidos <= 0) f->fim_arquivo = 1;
+            else f->buf_fim += (size_t)lidos;
+            f->buf[f->buf_fim] = '\0';
+            continue;
+        }
+
+        char *p = f->buf + f->buf_ini, *fim_ok = f->buf + limite;
+        while (p < fim_ok && k < FONTE_BLOCO) {
+            while (p < fim_ok && eh_separador_csv(*p)) ++p;
+            if (p >= fim_ok) break;
+            char *depois;
+            double x = strtod(p, &depois);
+            if (depois == p) {
+                // texto que não é número (ex: cabeçalho): pula até o próximo separador
+                while (p < fim_ok && !eh_separador_csv(*p)) ++p;
+                continue;
+            }
+            f->bloco[k++] = x;
+            p = depois;
+        }
+        f->buf_ini = (size_t)(p - f->buf);
+    }
+    return k;
+}
+
+// fonte_proximo_bloco: aponta *v para os próximos valores e devolve quantos são (0 = acabou);
+// são só para leitura, já que podem ser o próprio mapa
+size_t fonte_proximo_bloco(FonteNumeros *f, double **v) {
+    if (f->tipo == FONTE_CSV) {
+        *v = f->bloco;
+        return csv_proximo_bloco(f);
+    }
+    size_t resto = f->n - f->pos;
+    if (resto == 0) return 0;
+    if (f->sem_copia) {
+        // zero cópia: o bloco é um pedaço do próprio mapa (limitado pra caber em int)
+        size_t k = resto < FONTE_BLOCO_MAPA ? resto : FONTE_BLOCO_MAPA;
+        *v = (double *)f->mapa + f->pos;
+        f->pos += k;
+        return k;
+    }
+    size_t k = resto < FONTE_BLOCO ? resto : FONTE_BLOCO;
+    const unsigned char *bytes = (const unsigned char *)f->mapa;
+    int le = host_little_endian();
+    for (size_t i = 0; i < k; ++i) {
+        if (f->tipo == FONTE_F32) {
+            uint32_t u;
+            memcpy(&u, bytes + (f->pos + i) * 4, 4);
+            if (!le) u = __builtin_bswap32(u);
+            float x;
+            memcpy(&x, &u, 4);
+            f->bloco[i] = x;
+        } else {
+            uint64_t u;
+            memcpy(&u, bytes + (f->pos + i) * 8, 8);
+            u = __builtin_bswap64(u); // só chega aqui em host big-endian
+            memcpy(&f->bloco[i], &u, 8);
+        }
+    }
+    f->pos += k;
+    *v = f->bloco;
+    return k;
+}
+
+// fonte_media: uma passada, somando bloco a bloco com a estratégia escolhida
+double fonte_media(FonteNumeros *f, size_t *n, int *erro) {
+    AcumSoma acum;
+    acum_iniciar(&acum, estrategia_soma);
+    double *v;
+    size_t k;
+    *n = 0;
+    while ((k = fonte_proximo_bloco(f, &v)) > 0) {
+        acum_adicionar(&acum, v, k);
+        *n += k;
+    }
+    *erro = *n == 0;
+    return *n ? acum_resultado(&acum) / (double)*n : 0.0;
+}
+
+// fonte_desvio: duas passadas (média e depois desvios ao quadrado), sem guardar o arquivo na memória
+double fonte_desvio(FonteNumeros *f, size_t *n, int *erro) {
+    double m = fonte_media(f, n, erro);
+    if (*erro || !fonte_reiniciar(f)) { *erro = 1; return 0.0; }
+    AcumSoma acum;
+    acum_iniciar(&acum, estrategia_soma);
+    double *v;
+    size_t k;
+    while ((k = fonte_proximo_bloco(f, &v)) > 0) acum_desvios_quadrados(&acum, v, k, m);
+    return sqrt(acum_resultado(&acum) / (double)*n);
+}
+
+// fonte_extremo: máximo (sinal > 0) ou mínimo (sinal < 0) numa passada
+static double fonte_extremo(FonteNumeros *f, size_t *n, int *erro, int sinal) {
+    double *v, m = 0.0;
+    size_t k;
+    *n = 0;
+    while ((k = fonte_proximo_bloco(f, &v)) > 0) {
+        double b = sinal > 0 ? maximo(v, (int)k) : minimo(v, (int)k); // blocos cabem em int
+        if (*n == 0 || (sinal > 0 ? b > m : b < m)) m = b;
+        *n += k;
+    }
+    *erro = *n == 0;
+    return m;
+}
+
+double fonte_maximo(FonteNumeros *f, size_t *n, int *erro) { return fonte_extremo(f, n, erro, 1); }
+double fonte_minimo(FonteNumeros *f, size_t *n, int *erro) { return fonte_extremo(f, n, erro, -1); }
+
+// fonte_mediana: a seleção reordena os valores, então eles vão para um array nosso. Nos binários
+// o tamanho é conhecido e alocamos uma vez só (falha limpa se não couber); no CSV o array cresce
+// dobrando. A cópia lê o mapa em ordem, e o quickselect roda só na memória alocada
+double fonte_mediana(FonteNumeros *f, size_t *n, int *erro) {
+    double *todos = NULL, *v;
+    size_t cap = 0, k;
+    *n = 0;
+    if (f->tipo != FONTE_CSV && f->n > 0) {
+        todos = f->n <= SIZE_MAX / sizeof(double) ? malloc(sizeof(double) * f->n) : NULL;
+        if (!todos) { *n = f->n; *erro = 1; return 0.0; }
+        cap = f->n;
+    }
+    while ((k = fonte_proximo_bloco(f, &v)) > 0) {
+        if (*n + k > cap) {
+            size_t novo = cap ? cap : FONTE_BLOCO;
+            while (novo < *n + k) novo *= 2;
+            double *t = realloc(todos, sizeof(double) * novo);
+            if (!t) { free(todos); *n += k; *erro = 1; return 0.0; }
+            todos = t;
+            cap = novo;
+        }
+        memcpy(todos + *n, v, sizeof(double) * k);
+        *n += k;
+    }
+    *erro = *n == 0;
+    double med = *n ? mediana_no_lugar(todos, *n) : 0.0;
+    free(todos);
+    return med;
+}
+
+// fonte_ler: lê exatamente 'quantos' valores (usado pelas matrizes 2x2); retorna quantos conseguiu
+size_t fonte_ler(FonteNumeros *f, double *saida, size_t quantos) {
+    size_t lidos = 0, k;
+    double *v;
+    while (lidos < quantos && (k = fonte_proximo_bloco(f, &v)) > 0) {
+        size_t usar = k < quantos - lidos ? k : quantos - lidos;
+        memcpy(saida + lidos, v, sizeof(double) * usar);
+        lidos += usar;
+    }
+    return lidos;
+}
+
+/* Registro de operações: uma tabela estática descreve tudo que o menu, o lote e a CLI sabem calcular */
+
+// adaptadores: deixam todas as operações com a mesma assinatura FuncaoOp
+static double op_soma(double v[], int n, int *erro) { (void)n; *erro = 0; return soma(v[0], v[1]); }
+static double op_subtracao(double v[], int n, int *erro) { (void)n; *erro = 0; return subtracao(v[0], v[1]); }
+static double op_multiplicacao(double v[], int n, int *erro) { (void)n; *erro = 0; return multiplicacao(v[0], v[1]); }
+static double op_divisao(double v[], int n, int *erro) { (void)n; return divisao(v[0], v[1], erro); }
+static double op_potencia(double v[], int n, int *erro) { (void)n; *erro = 0; return potencia(v[0], v[1]); }
+static double op_raiz(double v[], int n, int *erro) { (void)n; return raiz(v[0], v[1], erro); }
+static double op_fatorial(double v[], int n, int *erro) { (void)n; return (double)fatorial((int)v[0], erro); }
+static double op_media(double v[], int n, int *erro) { *erro = 0; return media(v, n); }
+static double op_mediana(double v[], int n, int *erro) { *erro = 0; return mediana(v, n); }
+static double op_desvio(double v[], int n, int *erro) { *erro = 0; return desvio_padrao(v, n); }
+static double op_maximo(double v[], int n, int *erro) { *erro = 0; return maximo(v, n); }
+static double op_minimo(double v[], int n, int *erro) { *erro = 0; return minimo(v, n); }
+static double op_mdc(double v[], int n, int *erro) { (void)n; *erro = 0; return (double)mdc((long long)v[0], (long long)v[1]); }
+static double op_mmc(double v[], int n, int *erro) { (void)n; *erro = 0; return (double)mmc((long long)v[0], (long long)v[1]); }
+static double op_log(double v[], int n, int *erro) { (void)n; return meu_log(v[0], erro); }
+static double op_sin(double v[], int n, int *erro) { (void)n; *erro = 0; return trig_sin(graus_para_radianos(v[0])); }
+static double op_cos(double v[], int n, int *erro) { (void)n; *erro = 0; return trig_cos(graus_para_radianos(v[0])); }
+static double op_tan(double v[], int n, int *erro) { (void)n; return trig_tan(graus_para_radianos(v[0]), erro); }
+static double op_g2r(double v[], int n, int *erro) { (void)n; *erro = 0; return graus_para_radianos(v[0]); }
+static double op_r2g(double v[], int n, int *erro) { (void)n; *erro = 0; return radianos_para_graus(v[0]); }
+
+// OPERACOES: tabela montada em tempo de compilação (fica em .rodata, nada a inicializar na partida)
+static const DescritorOp OPERACOES[N_OPERACOES] = {
+    [OP_SOMA]          = {"SOMA", 2, op_soma, ERRO_NUNCA, NULL, "Resultado", {"A = ", "B = "}, 0},
+    [OP_SUBTRACAO]     = {"SUBTRACAO", 2, op_subtracao, ERRO_NUNCA, NULL, "Resultado", {"A = ", "B = "}, 0},
+    [OP_MULTIPLICACAO] = {"MULTIPLICACAO", 2, op_multiplicacao, ERRO_NUNCA, NULL, "Resultado", {"A = ", "B = "}, 0},
+    [OP_DIVISAO]       = {"DIVISAO", 2, op_divisao, ERRO_SINALIZA, "divisao por zero!", "Resultado", {"A = ", "B = "}, 0},
+    [OP_POTENCIA]      = {"POTENCIA", 2, op_potencia, ERRO_NUNCA, NULL, "Resultado", {"Base (A) = ", "Expoente (B) = "}, 0},
+    [OP_RAIZ]          = {"RAIZ", 2, op_raiz, ERRO_SINALIZA, "raiz invalida (verifique sinais/ordem).", "Resultado", {"Valor (A) = ", "Ordem (B) = "}, 0},
+    [OP_FATORIAL]      = {"FATORIAL", 1, op_fatorial, ERRO_SINALIZA, "fatorial invalido (negativo ou > " STR(FACT_LIMIT) ")", "N!", {"N (inteiro) = ", NULL}, 1},
+    [OP_MEDIA]         = {"MEDIA", ARIDADE_ARRAY, op_media, ERRO_NUNCA, NULL, "Media", {NULL, NULL}, 0, fonte_media},
+    [OP_MEDIANA]       = {"MEDIANA", ARIDADE_ARRAY, op_mediana, ERRO_NUNCA, NULL, "Mediana", {NULL, NULL}, 0, fonte_mediana},
+    [OP_DESVIO]        = {"DESVIO", ARIDADE_ARRAY, op_desvio, ERRO_NUNCA, NULL, "Desvio-padrao", {NULL, NULL}, 0, fonte_desvio},
+    [OP_MAXIMO]        = {"MAXIMO", ARIDADE_ARRAY, op_maximo, ERRO_NUNCA, NULL, "Maximo", {NULL, NULL}, 0, fonte_maximo},
+    [OP_MINIMO]        = {"MINIMO", ARIDADE_ARRAY, op_minimo, ERRO_NUNCA, NULL, "Minimo", {NULL, NULL}, 0, fonte_minimo},
+    [OP_MDC]           = {"MDC", 2, op_mdc, ERRO_NUNCA, NULL, "MDC", {"A (inteiro) = ", "B (inteiro) = "}, 1},
+    [OP_MMC]           = {"MMC", 2, op_mmc, ERRO_NUNCA, NULL, "MMC", {"A (inteiro) = ", "B (inteiro) = "}, 1},
+    [OP_LOG]           = {"LOG", 1, op_log, ERRO_SINALIZA, "log indefinido para valores <= 0.", "ln", {"Valor A = ", NULL}, 0},
+    [OP_SIN]           = {"SIN", 1, op_sin, ERRO_NUNCA, NULL, "sin", {"Angulo em graus: ", NULL}, 0},
+    [OP_COS]           = {"COS", 1, op_cos, ERRO_NUNCA, NULL, "cos", {"Angulo em graus: ", NULL}, 0},
+    [OP_TAN]           = {"TAN", 1, op_tan, ERRO_SINALIZA, "tangente indefinida para esse angulo.", "tan", {"Angulo em graus: ", NULL}, 0},
+    [OP_G2R]           = {"G2R", 1, op_g2r, ERRO_NUNCA, NULL, "Radianos", {"Angulo em graus: ", NULL}, 0},
+    [OP_R2G]           = {"R2G", 1, op_r2g, ERRO_NUNCA, NULL, "Graus", {"Angulo em radianos: ", NULL}, 0},
+    [OP_MAT_SOMA]      = {"MAT_SOMA", ARIDADE_MATRIZ, NULL, ERRO_NUNCA, NULL, "Resultado da soma", {NULL, NULL}, 0, NULL, soma_matriz_2x2},
+    [OP_MAT_MUL]       = {"MAT_MUL", ARIDADE_MATRIZ, NULL, ERRO_NUNCA, NULL, "Resultado da multiplicacao", {NULL, NULL}, 0, NULL, multiplica_matriz_2x2},
+};
+
+// buscar_operacao: acha o descritor pelo nome (NULL se não existir); 22 strcmp custam quase nada
+const DescritorOp *buscar_operacao(const char *nome) {
+    for (int i = 0; i < N_OPERACOES; ++i)
+        if (strcmp(OPERACOES[i].nome, nome) == 0) return &OPERACOES[i];
+    return NULL;
+}
+
+// aridade_aceita: confere se n operandos servem para a operação
+int aridade_aceita(const DescritorOp *d, int n) {
+    return d->aridade == ARIDADE_ARRAY ? n >= 1 : n == d->aridade;
+}
+
+// calcular_matriz: A e B vêm dos 8 operandos, por linha; R = d->fn_matriz(A, B)
+void calcular_matriz(const DescritorOp *d, const double v[], double R[2][2]) {
+    double A[2][2], B[2][2];
+    memcpy(A, v, sizeof(A));
+    memcpy(B, v + 4, sizeof(B));
+    d->fn_matriz(A, B, R);
+}
+
+// operandos_inteiros_ok: o menu lê essas operações com ler_inteiro; CLI e lote usam strtod,
+// então recusamos aqui o que não caberia num int (3.7, 1e300, nan) antes de converter
+int operandos_inteiros_ok(const DescritorOp *d, const double v[], int n) {
+    if (!d->inteiro) return 1;
+    for (int i = 0; i < n; ++i)
+        if (!(v[i] >= INT_MIN && v[i] <= INT_MAX) || v[i] != floor(v[i])) return 0;
+    return 1;
+}
+
+// formatar_resultado: inteiros (fatorial, mdc, mmc) saem sem notação científica
+void formatar_resultado(const DescritorOp *d, double res, char *buf, size_t cap) {
+    if (d->inteiro) snprintf(buf, cap, "%.0f", res);
+    else snprintf(buf, cap, "%.10g", res);
+}
+
+// operacao_falhou: só operações ERRO_SINALIZA podem falhar; nas ERRO_NUNCA o *erro é ignorado
+int operacao_falhou(const DescritorOp *d, int erro) {
+    return d->erros == ERRO_SINALIZA && erro;
+}
+
+// preencher_operacao: monta o registro do histórico (arrays guardam o tamanho em 'a')
+Operacao preencher_operacao(const DescritorOp *d, const double v[], int n, double res, int erro) {
+    Operacao op = {0};
+    snprintf(op.tipo, sizeof(op.tipo), "%s", d->nome);
+    if (d->fn_matriz) return op; // matrizes: o histórico guarda só o nome
+    if (d->aridade == ARIDADE_ARRAY) op.a = n;
+    else { op.a = v[0]; op.b = n > 1 ? v[1] : 0.0; }
+    op.resultado = operacao_falhou(d, erro) ? NAN : res;
+    return op;
+}
+
 /* Histórico (armazenamento em memória e persistência simples em CSV) */
 
 // adicionar_historico: insere op no array hist; se cheio, desloca (FIFO)
@@ -350,21 +1231,23 @@ void listar_historico(Operacao hist[], int count) {
     }
 }
 
-// salvar_historico_csv: grava o histórico em um arquivo CSV com cabeçalho
-void salvar_historico_csv(Operacao hist[], int count, const char *nome_arquivo) {
-    FILE *f = fopen(nome_arquivo, "w");
-    if (!f) {
-        printf("Erro ao abrir arquivo para salvar.\n");
-        return;
-    }
-    fprintf(f, "id,tipo,a,b,resultado\n");
-    for (int i = 0; i < count; ++i) {
-        // escrevemos com precisão suficiente para doubles
-        fprintf(f, "%d,%s,%.15g,%.15g,%.15g\n",
-                hist[i].id, hist[i].tipo, hist[i].a, hist[i].b, hist[i].resultado);
+// inicio_ultimas_linhas: procura de trás pra frente onde começam as últimas 'linhas' linhas do arquivo
+// (0 se o arquivo tem menos que isso); assim o custo não depende do tamanho do CSV
+static long inicio_ultimas_linhas(FILE *f, int linhas) {
+    char bloco[4096];
+    if (fseek(f, 0, SEEK_END) != 0) return 0;
+    long fim = ftell(f), pos = fim;
+    int achadas = 0;
+    while (pos > 0) {
+        long k = pos < (long)sizeof(bloco) ? pos : (long)sizeof(bloco);
+        pos -= k;
+        if (fseek(f, pos, SEEK_SET) != 0 || fread(bloco, 1, (size_t)k, f) != (size_t)k) return 0;
+        for (long i = k - 1; i >= 0; --i) {
+            // o '\n' que fecha a última linha não separa nada
+            if (bloco[i] == '\n' && pos + i != fim - 1 && ++achadas == linhas) return pos + i + 1;
+        }
     }
-    fclose(f);
-    printf("Historico salvo em '%s'\n", nome_arquivo);
+    return 0;
 }
 
 // carregar_historico_csv: tenta abrir e ler o CSV, retorna 1 se leu ok, 0 se falhou
@@ -372,361 +1255,1119 @@ int carregar_historico_csv(Operacao hist[], int *count, const char *nome_arquivo
     FILE *f = fopen(nome_arquivo, "r");
     if (!f) return 0; // se não existe arquivo, retornamos 0 (sem erro grave)
     char linha[MAX_LINE];
-    int idx = 0;
-    // lemos e descartamos o cabeçalho (esperamos que exista)
-    if (!fgets(linha, sizeof(linha), f)) { fclose(f); return 0; }
-    while (fgets(linha, sizeof(linha), f) && idx < MAX_HIST) {
+    *count = 0;
+    // o escritor só anexa (e só compacta ao sair), então lemos apenas as últimas MAX_HIST linhas;
+    // o cabeçalho, se cair no trecho, não passa no sscanf e é ignorado
+    if (fseek(f, inicio_ultimas_linhas(f, MAX_HIST), SEEK_SET) != 0) { fclose(f); return 0; }
+    while (fgets(linha, sizeof(linha), f)) {
         Operacao op;
         // inicializamos campos antes do parsing
         op.id = 0; op.tipo[0] = '\0'; op.a = op.b = op.resultado = 0.0;
         // fazemos um parsing simples; aceitaremos quando sscanf conseguir ao menos os primeiros itens
         if (sscanf(linha, "%d,%31[^,],%lf,%lf,%lf", &op.id, op.tipo, &op.a, &op.b, &op.resultado) >= 4) {
-            hist[idx++] = op;
+            adicionar_historico(hist, count, op);
         }
     }
     fclose(f);
-    *count = idx;
     return 1;
 }
 
-/* Função principal: menu interativo que chama todas as funcionalidades */
-int main() {
-    Operacao historico[MAX_HIST]; // buffer de histórico em memória
-    int hist_count = 0;           // quantas operações temos no histórico
-    int proximo_id = 1;           // id incremental para atribuir às operações
+// compactar_historico_csv: reescreve o CSV só com as entradas em memória (no máximo MAX_HIST),
+// num arquivo temporário renomeado por cima do original
+int compactar_historico_csv(Operacao hist[], int count, const char *nome_arquivo, int sincronizar) {
+    char tmp[MAX_LINE];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", nome_arquivo);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return 0;
+    fprintf(f, "id,tipo,a,b,resultado\n");
+    for (int i = 0; i < count; ++i) {
+        // escrevemos com precisão suficiente para doubles
+        fprintf(f, "%d,%s,%.15g,%.15g,%.15g\n",
+                hist[i].id, hist[i].tipo, hist[i].a, hist[i].b, hist[i].resultado);
+    }
+    int ok = fflush(f) == 0 && (!sincronizar || fsync(fileno(f)) == 0);
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, nome_arquivo) != 0) {
+        remove(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+/* Persistência assíncrona: o menu só enfileira, quem mexe no disco é a thread escritora */
 
-    // tentamos carregar historico.csv automaticamente (se existir)
-    if (carregar_historico_csv(historico, &hist_count, "historico.csv")) {
-        if (hist_count > 0) {
-            // se carregou, ajustamos o próximo id para não colidir
-            proximo_id = historico[hist_count - 1].id + 1;
-            printf("Historico carregado (%d itens).\n", hist_count);
+// ms_desde: milissegundos passados desde 'inicio' (relógio monotônico)
+static double ms_desde(const struct timespec *inicio) {
+    struct timespec agora;
+    clock_gettime(CLOCK_MONOTONIC, &agora);
+    return (agora.tv_sec - inicio->tv_sec) * 1e3 + (agora.tv_nsec - inicio->tv_nsec) / 1e6;
+}
+
+// escrever_tudo: write() pode gravar menos que o pedido, então repetimos até acabar
+static int escrever_tudo(int fd, const char *buf, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, buf, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
         }
+        buf += w;
+        n -= (size_t)w;
     }
+    return 0;
+}
+
+// gravar_lote: grava o texto acumulado e avisa se falhar (o lote nunca some em silêncio)
+static void gravar_lote(Persistencia *p, const char *buf, size_t n) {
+    if (n > 0 && escrever_tudo(p->fd, buf, n) != 0)
+        fprintf(stderr, "Erro ao gravar historico: %s\n", strerror(errno));
+}
+
+// drenar_fila: formata tudo que está na fila num buffer só e grava com um write por lote
+static size_t drenar_fila(Persistencia *p) {
+    char *buf = p->buf;
+    size_t cap = p->buf_cap;
+    FilaOperacoes *q = &p->fila;
+    size_t cabeca = atomic_load_explicit(&q->cabeca, memory_order_relaxed);
+    size_t cauda = atomic_load_explicit(&q->cauda, memory_order_acquire);
+    size_t total = 0, usado = 0;
+    while (cabeca != cauda) {
+        // MAX_LINE por linha sobra: tipo tem 50 chars e cada %.15g no máximo ~24
+        if (cap - usado < MAX_LINE) {
+            gravar_lote(p, buf, usado);
+            usado = 0;
+        }
+        const Operacao *op = &q->itens[cabeca & (FILA_CAP - 1)];
+        usado += (size_t)snprintf(buf + usado, cap - usado, "%d,%s,%.15g,%.15g,%.15g\n",
+                                  op->id, op->tipo, op->a, op->b, op->resultado);
+        ++cabeca;
+        ++total;
+        // liberamos o slot assim que copiamos, pro produtor não esperar o write
+        atomic_store_explicit(&q->cabeca, cabeca, memory_order_release);
+        if (cabeca == cauda) cauda = atomic_load_explicit(&q->cauda, memory_order_acquire);
+    }
+    gravar_lote(p, buf, usado);
+    return total;
+}
+
+// escritor_historico: laço da thread escritora (group commit + política de fsync)
+static void *escritor_historico(void *arg) {
+    Persistencia *p = arg;
+    struct timespec ultimo_fsync;
+    clock_gettime(CLOCK_MONOTONIC, &ultimo_fsync);
+    int pendente = 0; // 1 se gravamos algo que ainda não passou por fsync
 
-    // loop principal do menu; o programa roda até o usuário escolher sair
     while (1) {
-        printf("\n==== 𝖈𝖆𝖑𝖈𝖚𝖑𝖆𝖉𝖔𝖗𝖆DELUXE2.0 ====\n");
-        printf("1) Soma\n");
-        printf("2) Subtracao\n");
-        printf("3) Multiplicacao\n");
-        printf("4) Divisao\n");
-        printf("5) Potencia\n");
-        printf("6) Raiz\n");
-        printf("7) Fatorial\n");
-        printf("8) Media (array)\n");
-        printf("9) Mediana (array)\n");
-        printf("10) Desvio-padrao (array)\n");
-        printf("11) Maximo/Minimo (array)\n");
-        printf("12) MMC/MDC\n");
-        printf("13) Log natural\n");
-        printf("14) Trigonometria (sin/cos/tan)\n");
-        printf("15) Conversoes grau<->rad\n");
-        printf("16) Matriz 2x2 (soma/multiplicacao)\n");
-        printf("17) Historico (listar)\n");
-        printf("18) Salvar historico em CSV (historico.csv)\n");
-        printf("0) Sair\n");
+        if (p->politica == FSYNC_INTERVALO && pendente) {
+            // com dados pendentes, acordamos sozinhos quando o intervalo vencer
+            struct timespec limite;
+            clock_gettime(CLOCK_REALTIME, &limite);
+            limite.tv_sec += p->intervalo_ms / 1000;
+            limite.tv_nsec += (long)(p->intervalo_ms % 1000) * 1000000L;
+            if (limite.tv_nsec >= 1000000000L) { limite.tv_sec++; limite.tv_nsec -= 1000000000L; }
+            while (sem_timedwait(&p->sinal, &limite) != 0 && errno == EINTR) ;
+        } else {
+            while (sem_wait(&p->sinal) != 0 && errno == EINTR) ;
+        }
 
-        int opc = ler_inteiro("Escolha uma opcao: ");
+        int fim = atomic_load(&p->encerrar);
+        int flushes = atomic_exchange(&p->pedidos_flush, 0);
 
-        if (opc == 0) {
-            // antes de sair, salvamos o histórico para persistência
-            printf("Saindo...\n");
-            salvar_historico_csv(historico, hist_count, "historico.csv");
-            break;
+        if (drenar_fila(p) > 0) pendente = 1;
+
+        int sincronizar = 0;
+        if (pendente && p->politica != FSYNC_NUNCA) {
+            if (p->politica == FSYNC_POR_LOTE || flushes > 0 || fim) sincronizar = 1;
+            else if (ms_desde(&ultimo_fsync) >= p->intervalo_ms) sincronizar = 1;
+        }
+        if (sincronizar) {
+            fsync(p->fd);
+            clock_gettime(CLOCK_MONOTONIC, &ultimo_fsync);
         }
+        if (sincronizar || p->politica == FSYNC_NUNCA) pendente = 0;
 
-        // variáveis temporárias usadas nas várias operações
-        double a, b, res;
-        int erro;
-        char tipo_op[32];
+        for (int i = 0; i < flushes; ++i) sem_post(&p->flush_ok);
+        if (fim) break;
+    }
+    return NULL;
+}
 
-        switch (opc) {
-            case 1: // soma
-                a = ler_double("A = ");
-                b = ler_double("B = ");
-                res = soma(a, b);
-                printf("Resultado: %.10g\n", res);
-                snprintf(tipo_op, sizeof(tipo_op), "SOMA");
-                {
-                    Operacao op1 = {0};
-                    strcpy(op1.tipo, tipo_op);
-                    op1.a = a; op1.b = b; op1.resultado = res; op1.id = proximo_id++;
-                    adicionar_historico(historico, &hist_count, op1);
-                }
-                pausar();
-                break;
+// ler_politica_fsync: CALC_FSYNC=nunca|lote|intervalo e CALC_FSYNC_MS=<ms> (padrão: lote)
+static void ler_politica_fsync(Persistencia *p) {
+    const char *pol = getenv("CALC_FSYNC");
+    const char *ms = getenv("CALC_FSYNC_MS");
+    p->politica = FSYNC_POR_LOTE;
+    p->intervalo_ms = FSYNC_INTERVALO_MS;
+    if (pol) {
+        if (strcmp(pol, "nunca") == 0) p->politica = FSYNC_NUNCA;
+        else if (strcmp(pol, "intervalo") == 0) p->politica = FSYNC_INTERVALO;
+        else if (strcmp(pol, "lote") != 0)
+            fprintf(stderr, "CALC_FSYNC='%s' desconhecido, usando 'lote'.\n", pol);
+    }
+    if (ms && atoi(ms) > 0) p->intervalo_ms = atoi(ms);
+}
 
-            case 2: // subtração
-                a = ler_double("A = ");
-                b = ler_double("B = ");
-                res = subtracao(a, b);
-                printf("Resultado: %.10g\n", res);
-                snprintf(tipo_op, sizeof(tipo_op), "SUBTRACAO");
-                {
-                    Operacao op2 = {0};
-                    strcpy(op2.tipo, tipo_op);
-                    op2.a = a; op2.b = b; op2.resultado = res; op2.id = proximo_id++;
-                    adicionar_historico(historico, &hist_count, op2);
-                }
-                pausar();
-                break;
+// iniciar_persistencia: abre o CSV em append (cabeçalho se vazio) e cria a thread escritora
+int iniciar_persistencia(Persistencia *p, const char *nome_arquivo) {
+    memset(p, 0, sizeof(*p));
+    ler_politica_fsync(p);
+    p->fd = open(nome_arquivo, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (p->fd < 0) {
+        printf("Erro ao abrir '%s' para salvar, historico so em memoria.\n", nome_arquivo);
+        return 0;
+    }
+    // sem o buffer o escritor não conseguiria esvaziar a fila e o menu travaria nela
+    p->buf_cap = FILA_CAP * MAX_LINE;
+    p->buf = malloc(p->buf_cap);
+    if (!p->buf) {
+        close(p->fd);
+        printf("Sem memoria para o buffer do historico, historico so em memoria.\n");
+        return 0;
+    }
+    struct stat st;
+    if (fstat(p->fd, &st) == 0 && st.st_size == 0) {
+        const char *cab = "id,tipo,a,b,resultado\n";
+        escrever_tudo(p->fd, cab, strlen(cab));
+    }
+    atomic_init(&p->fila.cabeca, 0);
+    atomic_init(&p->fila.cauda, 0);
+    atomic_init(&p->pedidos_flush, 0);
+    atomic_init(&p->encerrar, 0);
+    sem_init(&p->sinal, 0, 0);
+    sem_init(&p->flush_ok, 0, 0);
+    if (pthread_create(&p->thread, NULL, escritor_historico, p) != 0) {
+        close(p->fd);
+        free(p->buf);
+        sem_destroy(&p->sinal);
+        sem_destroy(&p->flush_ok);
+        printf("Erro ao criar thread do historico, historico so em memoria.\n");
+        return 0;
+    }
+    p->ativo = 1;
+    return 1;
+}
 
-            case 3: // multiplicação
-                a = ler_double("A = ");
-                b = ler_double("B = ");
-                res = multiplicacao(a, b);
-                printf("Resultado: %.10g\n", res);
-                snprintf(tipo_op, sizeof(tipo_op), "MULTIPLICACAO");
-                {
-                    Operacao op3 = {0};
-                    strcpy(op3.tipo, tipo_op);
-                    op3.a = a; op3.b = b; op3.resultado = res; op3.id = proximo_id++;
-                    adicionar_historico(historico, &hist_count, op3);
-                }
-                pausar();
-                break;
+// enfileirar_operacao: copia op pra fila; só espera se o escritor estiver FILA_CAP itens atrás
+void enfileirar_operacao(Persistencia *p, Operacao op) {
+    if (!p->ativo) return;
+    FilaOperacoes *q = &p->fila;
+    size_t cauda = atomic_load_explicit(&q->cauda, memory_order_relaxed);
+    while (cauda - atomic_load_explicit(&q->cabeca, memory_order_acquire) >= FILA_CAP) {
+        sem_post(&p->sinal); // fila cheia: garante que o escritor está acordado e cede a vez
+        sched_yield();
+    }
+    q->itens[cauda & (FILA_CAP - 1)] = op;
+    atomic_store_explicit(&q->cauda, cauda + 1, memory_order_release);
+    sem_post(&p->sinal);
+}
 
-            case 4: // divisão com verificação de divisão por zero
-                a = ler_double("A = ");
-                b = ler_double("B = ");
-                res = divisao(a, b, &erro);
-                if (erro) printf("Erro: divisao por zero!\n");
-                else printf("Resultado: %.10g\n", res);
-                snprintf(tipo_op, sizeof(tipo_op), "DIVISAO");
-                {
-                    Operacao op4 = {0};
-                    strcpy(op4.tipo, tipo_op);
-                    op4.a = a; op4.b = b; op4.resultado = (erro? NAN: res); op4.id = proximo_id++;
-                    adicionar_historico(historico, &hist_count, op4);
-                }
-                pausar();
-                break;
+// sincronizar_persistencia: pede um flush e espera o escritor confirmar
+void sincronizar_persistencia(Persistencia *p) {
+    if (!p->ativo) return;
+    atomic_fetch_add(&p->pedidos_flush, 1);
+    sem_post(&p->sinal);
+    while (sem_wait(&p->flush_ok) != 0 && errno == EINTR) ;
+}
 
-            case 5: // potencia
-                a = ler_double("Base (A) = ");
-                b = ler_double("Expoente (B) = ");
-                res = potencia(a, b);
-                printf("Resultado: %.10g\n", res);
-                snprintf(tipo_op, sizeof(tipo_op), "POTENCIA");
-                {
-                    Operacao op5 = {0};
-                    strcpy(op5.tipo, tipo_op);
-                    op5.a = a; op5.b = b; op5.resultado = res; op5.id = proximo_id++;
-                    adicionar_historico(historico, &hist_count, op5);
-                }
-                pausar();
-                break;
+// encerrar_persistencia: manda o escritor drenar o que falta, sincronizar e terminar
+void encerrar_persistencia(Persistencia *p) {
+    if (!p->ativo) return;
+    atomic_store(&p->encerrar, 1);
+    sem_post(&p->sinal);
+    pthread_join(p->thread, NULL);
+    close(p->fd);
+    free(p->buf);
+    p->buf = NULL;
+    sem_destroy(&p->sinal);
+    sem_destroy(&p->flush_ok);
+    p->ativo = 0;
+}
 
-            case 6: // raiz
-                a = ler_double("Valor (A) = ");
-                b = ler_double("Ordem (B) = ");
-                res = raiz(a, b, &erro);
-                if (erro) printf("Erro: raiz invalida (verifique sinais/ordem).\n");
-                else printf("Resultado: %.10g\n", res);
-                snprintf(tipo_op, sizeof(tipo_op), "RAIZ");
-                {
-                    Operacao op6 = {0};
-                    strcpy(op6.tipo, tipo_op);
-                    op6.a = a; op6.b = b; op6.resultado = (erro? NAN: res); op6.id = proximo_id++;
-                    adicionar_historico(historico, &hist_count, op6);
-                }
-                pausar();
-                break;
+// registrar_operacao: guarda no histórico em memória e manda pro escritor persistir
+void registrar_operacao(Operacao hist[], int *count, Persistencia *p, Operacao op) {
+    adicionar_historico(hist, count, op);
+    enfileirar_operacao(p, op);
+}
 
-            case 7: // fatorial
-            {
-                int n = ler_inteiro("N (inteiro) = ");
-                unsigned long long f; int ferr;
-                f = fatorial(n, &ferr);
-                if (ferr) printf("Erro: fatorial inválido (negativo ou > %d)\n", FACT_LIMIT);
-                else printf("%d! = %llu\n", n, f);
-                snprintf(tipo_op, sizeof(tipo_op), "FATORIAL");
-                Operacao op7 = {0};
-                strcpy(op7.tipo, tipo_op);
-                op7.a = (double)n; op7.b = 0.0; op7.resultado = (double)f; op7.id = proximo_id++;
-                adicionar_historico(historico, &hist_count, op7);
-                pausar();
-                break;
-            }
+// historico_pronto: na primeira chamada lê o CSV e sobe o escritor; depois não faz nada
+Historico *historico_pronto(Historico *h) {
+    if (h->carregado) return h;
+    h->carregado = 1;
+    h->count = 0;
+    h->proximo_id = 1;
+    if (carregar_historico_csv(h->itens, &h->count, HIST_ARQUIVO) && h->count > 0) {
+        // se carregou, ajustamos o próximo id para não colidir
+        h->proximo_id = h->itens[h->count - 1].id + 1;
+        fprintf(stderr, "Historico carregado (%d itens).\n", h->count);
+    }
+    // cada operação nova é anexada ao CSV por uma thread separada
+    iniciar_persistencia(&h->persist, HIST_ARQUIVO);
+    return h;
+}
 
-            case 8: // média de array
-            {
-                int n = ler_inteiro("Quantos elementos? ");
-                if (n <= 0) { printf("Numero invalido.\n"); pausar(); break; }
-                double *arr = malloc(sizeof(double) * n); // alocamos dinamicamente o array
-                for (int i = 0; i < n; ++i) {
-                    char prm[64];
-                    sprintf(prm, "Elemento %d: ", i);
-                    arr[i] = ler_double(prm);
-                }
-                res = media(arr, n);
-                printf("Media = %.10g\n", res);
-                snprintf(tipo_op, sizeof(tipo_op), "MEDIA");
-                Operacao op8 = {0};
-                strcpy(op8.tipo, tipo_op);
-                op8.a = n; op8.b = 0; op8.resultado = res; op8.id = proximo_id++;
-                adicionar_historico(historico, &hist_count, op8);
-                free(arr);
-                pausar();
-                break;
-            }
+// historico_registrar: garante o histórico carregado, dá o próximo id e registra
+void historico_registrar(Historico *h, Operacao op) {
+    historico_pronto(h);
+    op.id = h->proximo_id++;
+    registrar_operacao(h->itens, &h->count, &h->persist, op);
+}
 
-            case 9: // mediana
-            {
-                int n = ler_inteiro("Quantos elementos? ");
-                if (n <= 0) { printf("Numero invalido.\n"); pausar(); break; }
-                double *arr = malloc(sizeof(double) * n);
-                for (int i = 0; i < n; ++i) {
-                    char prm[64];
-                    sprintf(prm, "Elemento %d: ", i);
-                    arr[i] = ler_double(prm);
-                }
-                res = mediana(arr, n);
-                printf("Mediana = %.10g\n", res);
-                snprintf(tipo_op, sizeof(tipo_op), "MEDIANA");
-                Operacao op9 = {0};
-                strcpy(op9.tipo, tipo_op);
-                op9.a = n; op9.b = 0; op9.resultado = res; op9.id = proximo_id++;
-                adicionar_historico(historico, &hist_count, op9);
-                free(arr);
-                pausar();
-                break;
+// historico_encerrar: se o histórico chegou a ser usado, espera o escritor gravar tudo
+// e compacta o CSV de volta para as últimas MAX_HIST operações; retorna 1 se havia o que salvar
+int historico_encerrar(Historico *h) {
+    if (!h->carregado || !h->persist.ativo) return 0;
+    int sincronizar = h->persist.politica != FSYNC_NUNCA;
+    encerrar_persistencia(&h->persist);
+    if (!compactar_historico_csv(h->itens, h->count, HIST_ARQUIVO, sincronizar))
+        fprintf(stderr, "Aviso: nao consegui compactar '%s'.\n", HIST_ARQUIVO);
+    return 1;
+}
+
+/* Modo lote: muitos arquivos de entrada processados por um pool com roubo de trabalho */
+
+// texto_anexar: printf num buffer que cresce sozinho (saída de cada arquivo fica em memória até o fim)
+static void texto_anexar(TextoSaida *t, const char *fmt, ...) {
+    va_list args;
+    while (1) {
+        size_t livre = t->cap - t->tam;
+        va_start(args, fmt);
+        int k = vsnprintf(t->dados ? t->dados + t->tam : NULL, livre, fmt, args);
+        va_end(args);
+        if (k < 0) return;
+        if ((size_t)k < livre) { t->tam += (size_t)k; return; }
+        size_t novo = t->cap ? t->cap * 2 : 4096;
+        while (novo - t->tam <= (size_t)k) novo *= 2;
+        char *p = realloc(t->dados, novo);
+        if (!p) return;
+        t->dados = p;
+        t->cap = novo;
+    }
+}
+
+// cmp_entrada_lote: ordena o histórico mesclado por arquivo e depois pela ordem dentro dele
+static int cmp_entrada_lote(const void *p1, const void *p2) {
+    const EntradaLote *x = p1, *y = p2;
+    if (x->arquivo != y->arquivo) return x->arquivo < y->arquivo ? -1 : 1;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+// guardar_historico_local: só as MAX_HIST operações mais recentes do lote chegam ao histórico,
+// e cada uma delas também está entre as MAX_HIST mais recentes do trabalhador que a calculou.
+// Um heap mínimo (a mais antiga na raiz) mantém essas e descarta o resto: memória fixa por thread
+static void guardar_historico_local(TrabalhadorLote *t, const EntradaLote *e) {
+    EntradaLote *hp = t->hist;
+    size_t i;
+    if (t->hist_n < MAX_HIST) {
+        // sobe a partir da última folha
+        i = t->hist_n++;
+        while (i > 0 && cmp_entrada_lote(e, &hp[(i - 1) / 2]) < 0) {
+            hp[i] = hp[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        hp[i] = *e;
+        return;
+    }
+    if (cmp_entrada_lote(e, &hp[0]) <= 0) return; // mais antiga que todas as guardadas
+    // substitui a raiz e desce
+    i = 0;
+    while (1) {
+        size_t f = 2 * i + 1;
+        if (f >= MAX_HIST) break;
+        if (f + 1 < MAX_HIST && cmp_entrada_lote(&hp[f + 1], &hp[f]) < 0) ++f;
+        if (cmp_entrada_lote(&hp[f], e) >= 0) break;
+        hp[i] = hp[f];
+        i = f;
+    }
+    hp[i] = *e;
+}
+
+// processar_arquivo_lote: lê uma linha "NOME v1 v2 ..." por vez, usando só o scratch do trabalhador
+static void processar_arquivo_lote(TrabalhadorLote *t, int idx) {
+    ArquivoLote *arq = &t->lote->arquivos[idx];
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    FILE *f = fopen(arq->nome, "r");
+    if (!f) {
+        texto_anexar(&arq->saida, "erro: nao consegui abrir o arquivo\n");
+        arq->ms = ms_desde(&inicio);
+        return;
+    }
+    int num_linha = 0;
+    ssize_t lidos;
+    while ((lidos = getline(&t->linha, &t->linha_cap, f)) != -1) {
+        ++num_linha;
+        char *p = t->linha;
+        while (*p == ' ' || *p == '\t') ++p;
+        if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#') continue; // linha vazia ou comentário
+
+        char nome[32];
+        int k = 0;
+        while (*p && *p != ' ' && *p != '\t' && *p != ',' && *p != '\n' && *p != '\r' && k < 31) nome[k++] = *p++;
+        nome[k] = '\0';
+
+        // operandos separados por espaço ou vírgula, acumulados no scratch do trabalhador
+        int n = 0, invalida = 0;
+        while (1) {
+            while (*p == ' ' || *p == '\t' || *p == ',') ++p;
+            if (*p == '\0' || *p == '\n' || *p == '\r') break;
+            char *fim;
+            double x = strtod(p, &fim);
+            if (fim == p) { invalida = 1; break; }
+            if ((size_t)n == t->scratch_cap) {
+                size_t novo = t->scratch_cap ? t->scratch_cap * 2 : 64;
+                double *s = realloc(t->scratch, sizeof(double) * novo);
+                if (!s) { invalida = 1; break; }
+                t->scratch = s;
+                t->scratch_cap = novo;
             }
+            t->scratch[n++] = x;
+            p = fim;
+        }
 
-            case 10: // desvio padrão
-            {
-                int n = ler_inteiro("Quantos elementos? ");
-                if (n <= 0) { printf("Numero invalido.\n"); pausar(); break; }
-                double *arr = malloc(sizeof(double) * n);
-                for (int i = 0; i < n; ++i) {
-                    char prm[64];
-                    sprintf(prm, "Elemento %d: ", i);
-                    arr[i] = ler_double(prm);
-                }
-                res = desvio_padrao(arr, n);
-                printf("Desvio-padrao = %.10g\n", res);
-                snprintf(tipo_op, sizeof(tipo_op), "DESVIO");
-                Operacao op10 = {0};
-                strcpy(op10.tipo, tipo_op);
-                op10.a = n; op10.b = 0; op10.resultado = res; op10.id = proximo_id++;
-                adicionar_historico(historico, &hist_count, op10);
-                free(arr);
-                pausar();
-                break;
+        const DescritorOp *d = buscar_operacao(nome);
+        if (invalida || !d || !aridade_aceita(d, n) || !operandos_inteiros_ok(d, t->scratch, n)) {
+            texto_anexar(&arq->saida, "linha %d: operacao invalida '%s'\n", num_linha, nome);
+            continue;
+        }
+        int erro = 0;
+        double res = 0.0;
+        if (d->fn_matriz) {
+            double R[2][2];
+            calcular_matriz(d, t->scratch, R);
+            texto_anexar(&arq->saida, "%s = %.10g %.10g %.10g %.10g\n", nome, R[0][0], R[0][1], R[1][0], R[1][1]);
+        } else {
+            res = d->fn(t->scratch, n, &erro);
+            if (operacao_falhou(d, erro)) {
+                texto_anexar(&arq->saida, "%s = erro\n", nome);
+            } else {
+                char txt[64];
+                formatar_resultado(d, res, txt, sizeof(txt));
+                texto_anexar(&arq->saida, "%s = %s\n", nome, txt);
             }
+        }
 
-            case 11: // máximo/minimo
-            {
-                int n = ler_inteiro("Quantos elementos? ");
-                if (n <= 0) { printf("Numero invalido.\n"); pausar(); break; }
-                double *arr = malloc(sizeof(double) * n);
-                for (int i = 0; i < n; ++i) {
-                    char prm[64];
-                    sprintf(prm, "Elemento %d: ", i);
-                    arr[i] = ler_double(prm);
+        // histórico local do trabalhador; vira histórico global só no merge final
+        EntradaLote e;
+        e.arquivo = idx;
+        e.seq = arq->n_ops++;
+        e.op = preencher_operacao(d, t->scratch, n, res, erro);
+        guardar_historico_local(t, &e);
+    }
+    fclose(f);
+    arq->ms = ms_desde(&inicio);
+}
+
+// pegar_tarefa: o dono tira do começo do próprio deque; sem trabalho, rouba do fim dos outros
+static int pegar_tarefa(TrabalhadorLote *t) {
+    int idx = -1;
+    pthread_mutex_lock(&t->trava);
+    if (t->inicio < t->fim) idx = t->inicio++;
+    pthread_mutex_unlock(&t->trava);
+    if (idx >= 0) return idx;
+
+    Lote *lote = t->lote;
+    for (int i = 1; i < lote->n_trab && idx < 0; ++i) {
+        TrabalhadorLote *v = &lote->trab[(t->id + i) % lote->n_trab];
+        pthread_mutex_lock(&v->trava);
+        if (v->inicio < v->fim) idx = --v->fim;
+        pthread_mutex_unlock(&v->trava);
+    }
+    if (idx >= 0) t->roubos++;
+    return idx;
+}
+
+// trabalhador_lote: laço de cada thread do pool (as tarefas são fixas, então vazio = acabou)
+static void *trabalhador_lote(void *arg) {
+    TrabalhadorLote *t = arg;
+    int idx;
+    while ((idx = pegar_tarefa(t)) >= 0) processar_arquivo_lote(t, idx);
+    return NULL;
+}
+
+// cmp_string: usado pelo qsort para listar diretórios em ordem alfabética
+static int cmp_string(const void *p1, const void *p2) {
+    return strcmp(*(char *const *)p1, *(char *const *)p2);
+}
+
+// coletar_arquivos_lote: transforma os argumentos (arquivos ou diretórios) numa lista de caminhos
+static int coletar_arquivos_lote(char **caminhos, int n, char ***saida) {
+    int total = 0, cap = 0;
+    char **lista = NULL;
+    for (int i = 0; i < n; ++i) {
+        struct stat st;
+        if (stat(caminhos[i], &st) != 0) {
+            fprintf(stderr, "Ignorando '%s': %s\n", caminhos[i], strerror(errno));
+            continue;
+        }
+        char **novos = NULL;
+        int n_novos = 0;
+        if (S_ISDIR(st.st_mode)) {
+            DIR *d = opendir(caminhos[i]);
+            if (!d) continue;
+            struct dirent *ent;
+            int cap_dir = 0;
+            while ((ent = readdir(d)) != NULL) {
+                if (ent->d_name[0] == '.') continue;
+                size_t tam = strlen(caminhos[i]) + strlen(ent->d_name) + 2;
+                char *c = malloc(tam);
+                snprintf(c, tam, "%s/%s", caminhos[i], ent->d_name);
+                struct stat st_ent;
+                if (stat(c, &st_ent) != 0 || !S_ISREG(st_ent.st_mode)) { free(c); continue; }
+                if (n_novos == cap_dir) {
+                    cap_dir = cap_dir ? cap_dir * 2 : 64;
+                    novos = realloc(novos, sizeof(char *) * cap_dir);
                 }
-                double mx = maximo(arr, n);
-                double mn = minimo(arr, n);
-                printf("Maximo = %.10g, Minimo = %.10g\n", mx, mn);
-                snprintf(tipo_op, sizeof(tipo_op), "MAXMIN");
-                Operacao op11 = {0};
-                strcpy(op11.tipo, tipo_op);
-                op11.a = mx; op11.b = mn; op11.resultado = 0.0; op11.id = proximo_id++;
-                adicionar_historico(historico, &hist_count, op11);
-                free(arr);
-                pausar();
-                break;
+                novos[n_novos++] = c;
             }
+            closedir(d);
+            qsort(novos, n_novos, sizeof(char *), cmp_string);
+        } else {
+            novos = malloc(sizeof(char *));
+            novos[0] = strdup(caminhos[i]);
+            n_novos = 1;
+        }
+        if (total + n_novos > cap) {
+            while (total + n_novos > cap) cap = cap ? cap * 2 : 64;
+            lista = realloc(lista, sizeof(char *) * cap);
+        }
+        memcpy(lista + total, novos, sizeof(char *) * n_novos);
+        total += n_novos;
+        free(novos);
+    }
+    *saida = lista;
+    return total;
+}
 
-            case 12: // MMC / MDC
-            {
-                long long x = (long long)ler_inteiro("A (inteiro) = ");
-                long long y = (long long)ler_inteiro("B (inteiro) = ");
-                long long g = mdc(x, y);
-                long long l = mmc(x, y);
-                printf("MDC = %lld, MMC = %lld\n", g, l);
-                snprintf(tipo_op, sizeof(tipo_op), "MDC_MMC");
-                Operacao op12 = {0};
-                strcpy(op12.tipo, tipo_op);
-                op12.a = (double)x; op12.b = (double)y; op12.resultado = (double)l; op12.id = proximo_id++;
-                adicionar_historico(historico, &hist_count, op12);
-                pausar();
-                break;
-            }
+// executar_lote: processa os arquivos em paralelo, imprime na ordem de entrada e mescla o histórico
+int executar_lote(char **caminhos, int n_caminhos, int n_threads, Historico *h) {
+    char **nomes;
+    int n_arq = coletar_arquivos_lote(caminhos, n_caminhos, &nomes);
+    if (n_arq == 0) {
+        fprintf(stderr, "Nenhum arquivo de entrada.\n");
+        free(nomes);
+        return 1;
+    }
+    if (n_threads <= 0) n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads <= 0) n_threads = 1;
+    if (n_threads > n_arq) n_threads = n_arq;
+
+    Lote lote;
+    lote.n_arquivos = n_arq;
+    lote.n_trab = n_threads;
+    lote.arquivos = calloc(n_arq, sizeof(ArquivoLote));
+    lote.trab = calloc(n_threads, sizeof(TrabalhadorLote));
+    for (int i = 0; i < n_arq; ++i) lote.arquivos[i].nome = nomes[i];
+
+    // cada trabalhador começa com um pedaço contíguo da lista; o roubo equilibra o resto
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    pthread_t *threads = malloc(sizeof(pthread_t) * n_threads);
+    for (int i = 0; i < n_threads; ++i) {
+        TrabalhadorLote *t = &lote.trab[i];
+        t->id = i;
+        t->lote = &lote;
+        t->inicio = (int)((long long)n_arq * i / n_threads);
+        t->fim = (int)((long long)n_arq * (i + 1) / n_threads);
+        pthread_mutex_init(&t->trava, NULL);
+    }
+    int criadas = 0;
+    for (int i = 1; i < n_threads; ++i) {
+        if (pthread_create(&threads[i], NULL, trabalhador_lote, &lote.trab[i]) != 0) break;
+        ++criadas;
+    }
+    trabalhador_lote(&lote.trab[0]); // a thread principal também trabalha (e rouba o que sobrar)
+    for (int i = 1; i <= criadas; ++i) pthread_join(threads[i], NULL);
+    double ms_calculo = ms_desde(&inicio);
+
+    // saída na ordem dos arquivos, cada um com seu tempo
+    long total_ops = 0;
+    int roubos = 0;
+    for (int i = 0; i < n_arq; ++i) {
+        ArquivoLote *arq = &lote.arquivos[i];
+        printf("== %s (%d ops, %.3f ms) ==\n", arq->nome, arq->n_ops, arq->ms);
+        if (arq->saida.tam) fwrite(arq->saida.dados, 1, arq->saida.tam, stdout);
+        total_ops += arq->n_ops;
+    }
 
-            case 13: // log natural
-            {
-                a = ler_double("Valor A = ");
-                res = meu_log(a, &erro);
-                if (erro) printf("Erro: log indefinido para valores <= 0.\n");
-                else printf("ln(%.10g) = %.10g\n", a, res);
-                snprintf(tipo_op, sizeof(tipo_op), "LOG");
-                Operacao op13 = {0};
-                strcpy(op13.tipo, tipo_op);
-                op13.a = a; op13.b = 0; op13.resultado = (erro? NAN: res); op13.id = proximo_id++;
-                adicionar_historico(historico, &hist_count, op13);
-                pausar();
-                break;
-            }
+    // mescla dos históricos locais: no máximo MAX_HIST por trabalhador; ordenados, só as
+    // últimas MAX_HIST entram no histórico e as outras operações apenas consomem ids
+    size_t n_todas = 0;
+    for (int i = 0; i < n_threads; ++i) n_todas += lote.trab[i].hist_n;
+    EntradaLote *todas = malloc(sizeof(EntradaLote) * (n_todas ? n_todas : 1));
+    size_t pos = 0;
+    for (int i = 0; i < n_threads; ++i) {
+        TrabalhadorLote *t = &lote.trab[i];
+        if (todas) memcpy(todas + pos, t->hist, sizeof(EntradaLote) * t->hist_n);
+        pos += t->hist_n;
+        roubos += t->roubos;
+        free(t->scratch);
+        free(t->linha);
+        pthread_mutex_destroy(&t->trava);
+    }
+    size_t n_fim = 0;
+    if (todas) {
+        qsort(todas, n_todas, sizeof(EntradaLote), cmp_entrada_lote);
+        n_fim = n_todas < MAX_HIST ? n_todas : MAX_HIST;
+    }
+    historico_pronto(h);
+    h->proximo_id += (int)(total_ops - (long)n_fim);
+    for (size_t i = n_todas - n_fim; i < n_todas; ++i) historico_registrar(h, todas[i].op);
+
+    // a vazão conta o tempo todo: cálculo, saída e mescla do histórico
+    double ms_total = ms_desde(&inicio);
+    double seg = ms_total > 0 ? ms_total / 1000.0 : 1e-3;
+    printf("Lote: %d arquivos, %ld operacoes com %d threads em %.3f s "
+           "(calculo %.3f s, saida+historico %.3f s; %.1f arquivos/s, %d roubos)\n",
+           n_arq, total_ops, n_threads, seg, ms_calculo / 1000.0, (ms_total - ms_calculo) / 1000.0,
+           n_arq / seg, roubos);
+
+    for (int i = 0; i < n_arq; ++i) {
+        free(lote.arquivos[i].saida.dados);
+        free(nomes[i]);
+    }
+    free(todas);
+    free(threads);
+    free(lote.arquivos);
+    free(lote.trab);
+    free(nomes);
+    return 0;
+}
 
-            case 14: // trigonometria (o usuário fornece o ângulo em graus)
-            {
-                printf("1) sin\n2) cos\n3) tan\n");
-                int t = ler_inteiro("Escolha: ");
-                a = ler_double("Angulo em graus: ");
-                double rad = graus_para_radianos(a);
-                if (t == 1) {
-                    res = trig_sin(rad);
-                    printf("sin(%.6g deg) = %.10g\n", a, res);
-                    snprintf(tipo_op, sizeof(tipo_op), "SIN");
-                } else if (t == 2) {
-                    res = trig_cos(rad);
-                    printf("cos(%.6g deg) = %.10g\n", a, res);
-                    snprintf(tipo_op, sizeof(tipo_op), "COS");
-                } else if (t == 3) {
-                    res = trig_tan(rad, &erro);
-                    if (erro) printf("Erro: tangente indefinida para esse angulo.\n");
-                    else printf("tan(%.6g deg) = %.10g\n", a, res);
-                    snprintf(tipo_op, sizeof(tipo_op), "TAN");
-                } else {
-                    printf("Opcao invalida.\n");
-                    pausar();
-                    break;
-                }
-                Operacao op14 = {0};
-                strcpy(op14.tipo, tipo_op);
-                op14.a = a; op14.b = 0; op14.resultado = (erro? NAN: res); op14.id = proximo_id++;
-                adicionar_historico(historico, &hist_count, op14);
-                pausar();
-                break;
+/* Menu, CLI de um tiro e benchmark de partida, todos guiados pelo registro */
+
+// MENU: opções 1..15 do menu apontam para entradas do registro (16 a 19 são tratadas à parte, no switch)
+static const ItemMenu MENU[] = {
+    {"Soma", MENU_UMA, {OP_SOMA}, 1, {NULL}},
+    {"Subtracao", MENU_UMA, {OP_SUBTRACAO}, 1, {NULL}},
+    {"Multiplicacao", MENU_UMA, {OP_MULTIPLICACAO}, 1, {NULL}},
+    {"Divisao", MENU_UMA, {OP_DIVISAO}, 1, {NULL}},
+    {"Potencia", MENU_UMA, {OP_POTENCIA}, 1, {NULL}},
+    {"Raiz", MENU_UMA, {OP_RAIZ}, 1, {NULL}},
+    {"Fatorial", MENU_UMA, {OP_FATORIAL}, 1, {NULL}},
+    {"Media (array)", MENU_UMA, {OP_MEDIA}, 1, {NULL}},
+    {"Mediana (array)", MENU_UMA, {OP_MEDIANA}, 1, {NULL}},
+    {"Desvio-padrao (array)", MENU_UMA, {OP_DESVIO}, 1, {NULL}},
+    {"Maximo/Minimo (array)", MENU_TODAS, {OP_MAXIMO, OP_MINIMO}, 2, {NULL}},
+    {"MMC/MDC", MENU_TODAS, {OP_MDC, OP_MMC}, 2, {NULL}},
+    {"Log natural", MENU_UMA, {OP_LOG}, 1, {NULL}},
+    {"Trigonometria (sin/cos/tan)", MENU_ESCOLHA, {OP_SIN, OP_COS, OP_TAN}, 3, {"sin", "cos", "tan"}},
+    {"Conversoes grau<->rad", MENU_ESCOLHA, {OP_G2R, OP_R2G}, 2, {"graus -> radianos", "radianos -> graus"}},
+};
+#define N_MENU ((int)(sizeof(MENU) / sizeof(MENU[0])))
+
+// ler_operandos: pede ao usuário os operandos que o descritor espera;
+// devolve n, 0 se inválido ou -1 se o usuário quer ler o array de um arquivo
+static int ler_operandos(const DescritorOp *d, double **v) {
+    if (d->aridade == ARIDADE_ARRAY) {
+        int n = ler_inteiro("Quantos elementos? (0 = ler de arquivo) ");
+        if (n == 0 && d->fn_fonte) return -1;
+        if (n <= 0) return 0;
+        *v = malloc(sizeof(double) * n); // alocamos dinamicamente o array
+        if (!*v) return 0;
+        for (int i = 0; i < n; ++i) {
+            char prm[64];
+            sprintf(prm, "Elemento %d: ", i);
+            (*v)[i] = ler_double(prm);
+        }
+        return n;
+    }
+    for (int i = 0; i < d->aridade; ++i) {
+        char *prm = (char *)d->prompts[i];
+        (*v)[i] = d->inteiro ? (double)ler_inteiro(prm) : ler_double(prm);
+    }
+    return d->aridade;
+}
+
+// tipo_fonte_por_extensao: .f32 -> float32, .csv/.txt -> texto, o resto é float64
+static TipoFonte tipo_fonte_por_extensao(const char *caminho) {
+    const char *ext = strrchr(caminho, '.');
+    if (ext && strcmp(ext, ".f32") == 0) return FONTE_F32;
+    if (ext && (strcmp(ext, ".csv") == 0 || strcmp(ext, ".txt") == 0)) return FONTE_CSV;
+    return FONTE_F64;
+}
+
+// calcular_fonte: roda a versão "arquivo" da operação desde o primeiro valor
+static double calcular_fonte(const DescritorOp *d, FonteNumeros *f, size_t *n, int *erro) {
+    if (!fonte_reiniciar(f)) { *erro = 1; *n = 0; return 0.0; }
+    return d->fn_fonte(f, n, erro);
+}
+
+// executar_item_arquivo: mesmas operações do item, lendo o array de um arquivo
+static void executar_item_arquivo(const int ops[], int n_ops, Historico *h) {
+    char caminho[MAX_LINE];
+    ler_linha("Arquivo (.f64, .f32 ou .csv): ", caminho, sizeof(caminho));
+    FonteNumeros f;
+    if (!abrir_fonte(&f, caminho, tipo_fonte_por_extensao(caminho))) {
+        printf("Erro: nao consegui abrir '%s'.\n", caminho);
+        return;
+    }
+    for (int i = 0; i < n_ops; ++i) {
+        const DescritorOp *d = &OPERACOES[ops[i]];
+        size_t n;
+        int erro = 0;
+        double res = calcular_fonte(d, &f, &n, &erro);
+        if (erro && n > 0) printf("Erro: sem memoria para os %zu valores de '%s'.\n", n, caminho);
+        else if (erro) printf("Erro: nenhum numero lido de '%s'.\n", caminho);
+        else printf("%s = %.10g (%zu valores)\n", d->rotulo, res, n);
+        Operacao op = preencher_operacao(d, NULL, 0, res, erro);
+        op.a = (double)n;
+        historico_registrar(h, op);
+    }
+    fechar_fonte(&f);
+}
+
+// executar_item_menu: lê os operandos uma vez e roda cada operação do item, registrando no histórico
+static void executar_item_menu(const ItemMenu *item, Historico *h) {
+    int ops[3], n_ops = item->n_ops;
+    memcpy(ops, item->ops, sizeof(ops));
+    if (item->tipo == MENU_ESCOLHA) {
+        for (int i = 0; i < item->n_ops; ++i) printf("%d) %s\n", i + 1, item->rotulos[i]);
+        int t = ler_inteiro("Escolha: ");
+        if (t < 1 || t > item->n_ops) { printf("Opcao invalida.\n"); return; }
+        ops[0] = item->ops[t - 1];
+        n_ops = 1;
+    }
+
+    const DescritorOp *primeiro = &OPERACOES[ops[0]];
+    double fixos[2] = {0.0, 0.0};
+    double *v = fixos;
+    int n = ler_operandos(primeiro, &v);
+    if (n == -1) { executar_item_arquivo(ops, n_ops, h); return; }
+    if (n == 0) { printf("Numero invalido.\n"); return; }
+
+    for (int i = 0; i < n_ops; ++i) {
+        const DescritorOp *d = &OPERACOES[ops[i]];
+        int erro = 0;
+        double res = d->fn(v, n, &erro);
+        if (operacao_falhou(d, erro)) {
+            printf("Erro: %s\n", d->msg_erro);
+        } else {
+            char txt[64];
+            formatar_resultado(d, res, txt, sizeof(txt));
+            printf("%s = %s\n", d->rotulo, txt);
+        }
+        historico_registrar(h, preencher_operacao(d, v, n, res, erro));
+    }
+    if (v != fixos) free(v);
+}
+
+// executar_cli_arquivo: "calc MEDIA --f64 dados.bin" (arrays) ou "calc MAT_MUL --f64 m.bin" (8 valores: A e B)
+static int executar_cli_arquivo(const char *nome, TipoFonte tipo, const char *caminho) {
+    const DescritorOp *d = buscar_operacao(nome);
+    if (!d || (!d->fn_fonte && !d->fn_matriz)) {
+        fprintf(stderr, "%s nao aceita arquivo de entrada\n", nome);
+        return 2;
+    }
+    FonteNumeros f;
+    if (!abrir_fonte(&f, caminho, tipo)) {
+        fprintf(stderr, "Erro ao abrir '%s': %s\n", caminho, strerror(errno));
+        return 1;
+    }
+    int rc = 0;
+    if (d->fn_matriz) {
+        double m[ARIDADE_MATRIZ], R[2][2];
+        if (fonte_ler(&f, m, ARIDADE_MATRIZ) < ARIDADE_MATRIZ) {
+            fprintf(stderr, "Erro: '%s' precisa de %d valores (A e B, por linha)\n", caminho, ARIDADE_MATRIZ);
+            rc = 1;
+        } else {
+            calcular_matriz(d, m, R);
+            imprimir_matriz_2x2(R);
+        }
+    } else {
+        size_t n;
+        int erro = 0;
+        double res = d->fn_fonte(&f, &n, &erro);
+        if (erro) {
+            if (n > 0) fprintf(stderr, "Erro: sem memoria para os %zu valores de '%s'\n", n, caminho);
+            else fprintf(stderr, "Erro: nenhum numero lido de '%s'\n", caminho);
+            rc = 1;
+        } else {
+            printf("%.10g\n", res);
+        }
+    }
+    fechar_fonte(&f);
+    return rc;
+}
+
+// executar_cli: "calc NOME a b ..." calcula uma vez e sai (sem menu e sem tocar no histórico)
+static int executar_cli(const DescritorOp *d, int argc, char **argv) {
+    double fixos[2];
+    double *v = fixos;
+    if (argc > 2) {
+        v = malloc(sizeof(double) * argc); // arrays maiores que 2 operandos
+        if (!v) return 1;
+    }
+    for (int i = 0; i < argc; ++i) {
+        char *fim;
+        v[i] = strtod(argv[i], &fim);
+        if (fim == argv[i] || *fim != '\0') {
+            fprintf(stderr, "Operando invalido: '%s'\n", argv[i]);
+            if (v != fixos) free(v);
+            return 2;
+        }
+    }
+    int rc = 0;
+    if (!aridade_aceita(d, argc)) {
+        if (d->aridade == ARIDADE_ARRAY) fprintf(stderr, "%s espera pelo menos 1 operando\n", d->nome);
+        else fprintf(stderr, "%s espera %d operando(s)\n", d->nome, d->aridade);
+        rc = 2;
+    } else if (!operandos_inteiros_ok(d, v, argc)) {
+        fprintf(stderr, "%s espera operandos inteiros entre %d e %d\n", d->nome, INT_MIN, INT_MAX);
+        rc = 2;
+    } else if (d->fn_matriz) {
+        double R[2][2];
+        calcular_matriz(d, v, R);
+        imprimir_matriz_2x2(R);
+    } else {
+        int erro = 0;
+        double res = d->fn(v, argc, &erro);
+        if (operacao_falhou(d, erro)) {
+            fprintf(stderr, "Erro: %s\n", d->msg_erro);
+            rc = 1;
+        } else {
+            char txt[64];
+            formatar_resultado(d, res, txt, sizeof(txt));
+            puts(txt);
+        }
+    }
+    if (v != fixos) free(v);
+    return rc;
+}
+
+// bench_partida: mede a partida a frio rodando "calc SOMA 2 3" N vezes como processo novo,
+// e o custo só do despacho (busca no registro + cálculo) dentro do processo
+static int bench_partida(int repeticoes) {
+    char *args[] = {"calc", "SOMA", "2", "3", NULL};
+    posix_spawn_file_actions_t acoes;
+    posix_spawn_file_actions_init(&acoes);
+    posix_spawn_file_actions_addopen(&acoes, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    double total = 0.0, melhor = 1e30;
+    for (int i = 0; i < repeticoes; ++i) {
+        struct timespec inicio;
+        clock_gettime(CLOCK_MONOTONIC, &inicio);
+        pid_t pid;
+        if (posix_spawn(&pid, "/proc/self/exe", &acoes, NULL, args, environ) != 0) {
+            fprintf(stderr, "Erro ao executar /proc/self/exe\n");
+            posix_spawn_file_actions_destroy(&acoes);
+            return 1;
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        double ms = ms_desde(&inicio);
+        total += ms;
+        if (ms < melhor) melhor = ms;
+    }
+    posix_spawn_file_actions_destroy(&acoes);
+
+    // despacho: o mesmo caminho da CLI, sem o custo de criar processo
+    const int voltas = 1000000;
+    volatile double acumulado = 0.0;
+    char *nomes[] = {"SOMA", "R2G", "MINIMO"};
+    double v[2] = {2.0, 3.0};
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    for (int i = 0; i < voltas; ++i) {
+        const DescritorOp *d = buscar_operacao(nomes[i % 3]);
+        int erro;
+        acumulado += d->fn(v, 2 - (d->aridade == 1), &erro);
+    }
+    double ns = ms_desde(&inicio) * 1e6 / voltas;
+
+    printf("Partida a frio (calc SOMA 2 3, %d execucoes): media %.3f ms, melhor %.3f ms\n",
+           repeticoes, total / repeticoes, melhor);
+    printf("Despacho no processo (busca + calculo): %.1f ns por operacao\n", ns);
+    return 0;
+}
+
+// aleatorio_u01: xorshift64* simples e determinístico, só para gerar dados de benchmark
+static double aleatorio_u01(uint64_t *estado) {
+    *estado ^= *estado >> 12;
+    *estado ^= *estado << 25;
+    *estado ^= *estado >> 27;
+    return (double)((*estado * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53;
+}
+
+// gerar_dados_soma: conjuntos de teste, do bem condicionado ao adversarial
+static const char *gerar_dados_soma(int tipo, double *v, size_t n, uint64_t *estado) {
+    switch (tipo) {
+        case 0:
+            for (size_t i = 0; i < n; ++i) v[i] = aleatorio_u01(estado);
+            return "uniforme [0,1)";
+        case 1:
+            for (size_t i = 0; i < n; ++i) {
+                double x = ldexp(aleatorio_u01(estado), (int)(aleatorio_u01(estado) * 120) - 60);
+                v[i] = aleatorio_u01(estado) < 0.5 ? -x : x;
+            }
+            return "escalas 2^-60..2^60";
+        case 2:
+            // pares (x, -x + pequeno) embaralhados: quase tudo se cancela
+            for (size_t i = 0; i + 1 < n; i += 2) {
+                double x = ldexp(aleatorio_u01(estado), (int)(aleatorio_u01(estado) * 40));
+                v[i] = x;
+                v[i + 1] = -x + aleatorio_u01(estado) * 1e-6;
+            }
+            if (n % 2) v[n - 1] = 0.0;
+            for (size_t i = n - 1; i > 0; --i) {
+                size_t j = (size_t)(aleatorio_u01(estado) * (double)(i + 1));
+                double t = v[i]; v[i] = v[j]; v[j] = t;
             }
+            return "cancelamento";
+        case 3:
+            for (size_t i = 0; i < n; ++i) {
+                static const double padrao[4] = {1.0, 1e100, 1.0, -1e100};
+                v[i] = padrao[i % 4];
+            }
+            return "1, 1e100, 1, -1e100";
+        default:
+            for (size_t i = 0; i < n; ++i) v[i] = 1.0 / (double)(i + 1);
+            return "harmonica 1/i";
+    }
+}
 
-            case 15: // conversoes grau <-> rad
-            {
-                printf("1) graus -> radianos\n2) radianos -> graus\n");
-                int t = ler_inteiro("Escolha: ");
-                if (t == 1) {
-                    a = ler_double("Angulo em graus: ");
-                    res = graus_para_radianos(a);
-                    printf("%.10g graus = %.10g rad\n", a, res);
-                    snprintf(tipo_op, sizeof(tipo_op), "G2R");
-                } else if (t == 2) {
-                    a = ler_double("Angulo em radianos: ");
-                    res = radianos_para_graus(a);
-                    printf("%.10g rad = %.10g graus\n", a, res);
-                    snprintf(tipo_op, sizeof(tipo_op), "R2G");
-                } else {
-                    printf("Opcao invalida.\n"); pausar(); break;
-                }
-                Operacao op15 = {0};
-                strcpy(op15.tipo, tipo_op);
-                op15.a = a; op15.b = 0; op15.resultado = res; op15.id = proximo_id++;
-                adicionar_historico(historico, &hist_count, op15);
-                pausar();
-                break;
+// bench_soma: tabela precisão x velocidade das estratégias de soma (referência = soma exata)
+static int bench_soma(size_t n) {
+    double *v = malloc(sizeof(double) * n);
+    if (!v) { fprintf(stderr, "Sem memoria para %zu elementos\n", n); return 1; }
+    uint64_t estado = 0x9E3779B97F4A7C15ULL;
+    printf("%-22s %-8s %10s %14s\n", "dados", "soma", "ns/elem", "erro relativo");
+    for (int tipo = 0; tipo < 5; ++tipo) {
+        const char *nome = gerar_dados_soma(tipo, v, n, &estado);
+        double ref = somar_com(SOMA_EXATA, v, n);
+        for (int e = SOMA_INGENUA; e <= SOMA_EXATA; ++e) {
+            double melhor = 1e30, s = 0.0;
+            for (int rep = 0; rep < 5; ++rep) {
+                struct timespec inicio;
+                clock_gettime(CLOCK_MONOTONIC, &inicio);
+                s = somar_com((EstrategiaSoma)e, v, n);
+                double ms = ms_desde(&inicio);
+                if (ms < melhor) melhor = ms;
             }
+            double erro = ref != 0.0 ? fabs(s - ref) / fabs(ref) : fabs(s);
+            printf("%-22s %-8s %10.3f %14.2e\n", nome, nome_estrategia_soma((EstrategiaSoma)e),
+                   melhor * 1e6 / (double)n, erro);
+        }
+    }
+    free(v);
+    return 0;
+}
+
+// conferir_valor: compara r com o esperado (tol = erro relativo aceito; 0 exige o mesmo double)
+// e imprime a linha do relatório
+static int conferir_valor(const char *caso, const char *rotulo, double r, double esperado, double tol) {
+    int ok;
+    if (isnan(esperado)) ok = isnan(r) != 0;
+    else if (tol == 0.0 || isinf(esperado)) ok = r == esperado;
+    else ok = fabs(r - esperado) <= tol * fabs(esperado);
+    printf("%-7s %-30s %-16s obtido %-24.17g esperado %.17g\n", ok ? "ok" : "FALHOU", caso, rotulo, r, esperado);
+    return ok;
+}
+
+// conferir_soma: soma v com a estratégia e e compara com o esperado. Também soma em pedaços
+// pelo acumulador, que tem de cumprir a mesma tolerância
+static int conferir_soma(const char *caso, EstrategiaSoma e, const double *v, size_t n,
+                         double esperado, double tol) {
+    AcumSoma a;
+    acum_iniciar(&a, e);
+    for (size_t i = 0; i < n; i += 7) acum_adicionar(&a, v + i, n - i < 7 ? n - i : 7);
+    int ok = conferir_valor(caso, nome_estrategia_soma(e), somar_com(e, v, n), esperado, tol);
+    double r_pedacos = acum_resultado(&a);
+    if (!conferir_valor(caso, "(em pedacos)", r_pedacos, esperado, tol)) ok = 0;
+    return ok;
+}
+
+// conferir_estatisticas: media e desvio_padrao com a estratégia e, e o desvio de novo passando
+// por acum_desvios_quadrados em blocos de 1000 (como o caminho que lê de arquivo)
+static int conferir_estatisticas(const char *caso, EstrategiaSoma e, double *v, int n,
+                                 double media_esperada, double desvio_esperado, double tol) {
+    EstrategiaSoma antes = estrategia_soma;
+    estrategia_soma = e;
+    char rotulo[32];
+    snprintf(rotulo, sizeof(rotulo), "media %s", nome_estrategia_soma(e));
+    int ok = conferir_valor(caso, rotulo, media(v, n), media_esperada, tol);
+    snprintf(rotulo, sizeof(rotulo), "desvio %s", nome_estrategia_soma(e));
+    ok &= conferir_valor(caso, rotulo, desvio_padrao(v, n), desvio_esperado, tol);
+
+    double m = media(v, n);
+    AcumSoma a;
+    acum_iniciar(&a, e);
+    for (int i = 0; i < n; i += 1000) acum_desvios_quadrados(&a, v + i, (size_t)(n - i < 1000 ? n - i : 1000), m);
+    snprintf(rotulo, sizeof(rotulo), "blocos %s", nome_estrategia_soma(e));
+    ok &= conferir_valor(caso, rotulo, sqrt(acum_resultado(&a) / (double)n), desvio_esperado, tol);
+    estrategia_soma = antes;
+    return ok;
+}
+
+// teste_soma: casos com resposta conhecida para as somas e para media/desvio_padrao com cada
+// estratégia; sai com 1 se algum falhar
+static int teste_soma(void) {
+    enum { N_PADRAO = 1000, N_ALEATORIO = 200000, N_GRANDE = 1 << 20 };
+    enum { K = 1 << SOMA_KAHAN, P = 1 << SOMA_PAREADA, X = 1 << SOMA_EXATA };
+    static double v[N_GRANDE];
+    const double sub = 0x1p-1074;
+    int falhas = 0;
+
+    // estrategias: quais têm de acertar o double exato (a ordem de soma da pareada não
+    // compensa nada, então ela só entra onde qualquer ordem dá o mesmo resultado)
+    struct { const char *caso; double v[4]; int n; double esperado; int estrategias; } fixos[] = {
+        {"cancelamento 1e16+1-1e16", {1e16, 1.0, -1e16}, 3, 1.0, K | X},
+        {"subnormais 3 x 2^-1074", {sub, sub, sub}, 3, 3 * sub, K | P | X},
+        {"subnormal DBL_MIN - 2^-1074", {DBL_MIN, -sub}, 2, DBL_MIN - sub, K | P | X},
+        {"subnormal 2^-1074 - 2^-1074", {sub, -sub}, 2, 0.0, K | P | X},
+        {"empate 1 + 2^-53", {1.0, 0x1p-53}, 2, 1.0, K | P | X},
+        {"empate 1 + 2^-53 + 2^-106", {1.0, 0x1p-53, 0x1p-106}, 3, 1.0 + 0x1p-52, X},
+        {"DBL_MAX + DBL_MAX - DBL_MAX", {DBL_MAX, DBL_MAX, -DBL_MAX}, 3, DBL_MAX, X},
+        {"1 + inf", {1.0, INFINITY}, 2, INFINITY, K | P | X},
+        {"-inf + 1e300", {-INFINITY, 1e300}, 2, -INFINITY, K | P | X},
+        {"inf - inf", {INFINITY, -INFINITY}, 2, NAN, K | P | X},
+        {"nan + 1", {NAN, 1.0}, 2, NAN, K | P | X},
+    };
+    for (size_t i = 0; i < sizeof(fixos) / sizeof(fixos[0]); ++i)
+        for (int e = SOMA_KAHAN; e <= SOMA_EXATA; ++e)
+            if (fixos[i].estrategias & (1 << e))
+                falhas += !conferir_soma(fixos[i].caso, (EstrategiaSoma)e, fixos[i].v, (size_t)fixos[i].n,
+                                         fixos[i].esperado, 0.0);
+
+    // 1, 1e100, 1, -1e100 repetido: a ingênua e a pareada dão 0; passa por todas as faixas do Kahan
+    for (int i = 0; i < N_PADRAO; ++i) {
+        static const double padrao[4] = {1.0, 1e100, 1.0, -1e100};
+        v[i] = padrao[i % 4];
+    }
+    falhas += !conferir_soma("1, 1e100, 1, -1e100 x 250", SOMA_EXATA, v, N_PADRAO, N_PADRAO / 2, 0.0);
+    falhas += !conferir_soma("1, 1e100, 1, -1e100 x 250", SOMA_KAHAN, v, N_PADRAO, N_PADRAO / 2, 0.0);
+
+    // inteiros de até 2^40 escalados por 2^-30: a referência sai exata de uma soma em int64,
+    // mas o resultado ocupa mais bits que um double e a ingênua erra. O tamanho passa de
+    // SUPERACC_LOTE, então a exata cruza mais de um lote entre normalizações
+    uint64_t estado = 0x9E3779B97F4A7C15ULL;
+    int64_t ref = 0;
+    for (int i = 0; i < N_ALEATORIO; ++i) {
+        int64_t x = (int64_t)(aleatorio_u01(&estado) * 0x1p40);
+        if (aleatorio_u01(&estado) < 0.5) x = -x;
+        if (i % 1000 == 0) x = (int64_t)1 << 52; // alguns valores grandes para exigir a compensação
+        ref += x;
+        v[i] = ldexp((double)x, -30);
+    }
+    double esperado = ldexp((double)ref, -30); // um único arredondamento: o double mais próximo
+    falhas += !conferir_soma("inteiros * 2^-30 (aleatorio)", SOMA_EXATA, v, N_ALEATORIO, esperado, 0.0);
+    falhas += !conferir_soma("inteiros * 2^-30 (aleatorio)", SOMA_KAHAN, v, N_ALEATORIO, esperado, DBL_EPSILON);
+    falhas += !conferir_soma("inteiros * 2^-30 (aleatorio)", SOMA_PAREADA, v, N_ALEATORIO, esperado, 1e-14);
+
+    // harmônica 1/i: tudo positivo, então o erro relativo da pareada fica em O(eps log n)
+    for (int i = 0; i < N_ALEATORIO; ++i) v[i] = 1.0 / (double)(i + 1);
+    esperado = somar_com(SOMA_EXATA, v, N_ALEATORIO);
+    falhas += !conferir_soma("harmonica 1/i", SOMA_PAREADA, v, N_ALEATORIO, esperado, 1e-15);
+    falhas += !conferir_soma("harmonica 1/i", SOMA_KAHAN, v, N_ALEATORIO, esperado, DBL_EPSILON);
+
+    // deslocamento grande e espalhamento pequeno: 1e9 + {1, 2, 3, 4}. Média, desvios e quadrados
+    // são exatos, então toda estratégia tem de dar o double exato (desvio = sqrt(1.25))
+    for (int i = 0; i < N_PADRAO; ++i) v[i] = 1e9 + (double)(i % 4 + 1);
+    for (int e = SOMA_INGENUA; e <= SOMA_EXATA; ++e)
+        falhas += !conferir_estatisticas("1e9 + {1,2,3,4} x 250", (EstrategiaSoma)e, v, N_PADRAO,
+                                         1e9 + 2.5, sqrt(1.25), 0.0);
+
+    // 1e9 + i * 2^-20, i < 2^20: os valores são exatos, mas as somas parciais (~1e15) perdem
+    // os bits baixos. Fórmulas fechadas: média 1e9 + (N - 1) / 2 * 2^-20 e desvio 2^-20 * sqrt((N^2 - 1) / 12)
+    for (int i = 0; i < N_GRANDE; ++i) v[i] = 1e9 + ldexp((double)i, -20);
+    double media_esperada = 1e9 + ldexp((double)(N_GRANDE - 1) / 2.0, -20);
+    double desvio_esperado = ldexp(sqrt(((double)N_GRANDE * N_GRANDE - 1.0) / 12.0), -20);
+    static const double tol_rampa[] = {
+        [SOMA_INGENUA] = 1e-5, // a ingênua não acerta: a média erra ~5e-13 e o desvio ~1e-6 (relativos)
+        [SOMA_KAHAN] = 4 * DBL_EPSILON,
+        [SOMA_PAREADA] = 1e-13, // erro da pareada cresce com log2(n) * eps
+        [SOMA_EXATA] = 4 * DBL_EPSILON,
+    };
+    for (int e = SOMA_INGENUA; e <= SOMA_EXATA; ++e)
+        falhas += !conferir_estatisticas("1e9 + i * 2^-20, i < 2^20", (EstrategiaSoma)e, v, N_GRANDE,
+                                         media_esperada, desvio_esperado, tol_rampa[e]);
+
+    printf("%s: %d falha(s)\n", falhas ? "FALHOU" : "ok", falhas);
+    return falhas ? 1 : 0;
+}
+
+/* Função principal: menu interativo que chama todas as funcionalidades */
+int main(int argc, char **argv) {
+    // estratégia de soma: CALC_SOMA=... ou --soma NOME antes de qualquer outro argumento
+    const char *soma_env = getenv("CALC_SOMA");
+    if (soma_env && !definir_estrategia_soma(soma_env))
+        fprintf(stderr, "CALC_SOMA='%s' desconhecido, usando 'ingenua'.\n", soma_env);
+    if (argc >= 3 && strcmp(argv[1], "--soma") == 0) {
+        if (!definir_estrategia_soma(argv[2])) {
+            fprintf(stderr, "Estrategia de soma desconhecida: '%s' (ingenua, kahan, pareada, exata)\n", argv[2]);
+            return 2;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    // arrays/matrizes lidos de arquivo: calc MEDIA --f64 dados.bin (--f32, --csv)
+    if (argc == 4 && argv[2][0] == '-' && tipo_fonte_por_nome(argv[2]) >= 0)
+        return executar_cli_arquivo(argv[1], (TipoFonte)tipo_fonte_por_nome(argv[2]), argv[3]);
+
+    // CLI de um tiro: calc SOMA 2 3 (nada de histórico, nada de thread)
+    if (argc >= 2) {
+        const DescritorOp *d = buscar_operacao(argv[1]);
+        if (d) return executar_cli(d, argc - 2, argv + 2);
+    }
+
+    // o histórico só é lido do disco quando alguém precisar dele (lazy)
+    static Historico historico;
+
+    // modo lote: calc --lote [-j N] arquivos_ou_diretorios...
+    if (argc >= 2 && strcmp(argv[1], "--lote") == 0) {
+        int primeiro = 2, n_threads = 0;
+        if (argc >= 4 && strcmp(argv[2], "-j") == 0) {
+            n_threads = atoi(argv[3]);
+            primeiro = 4;
+        }
+        int rc = executar_lote(argv + primeiro, argc - primeiro, n_threads, &historico);
+        historico_encerrar(&historico);
+        return rc;
+    }
+
+    // benchmark de partida: calc --bench-partida [N]
+    if (argc >= 2 && strcmp(argv[1], "--bench-partida") == 0)
+        return bench_partida(argc >= 3 ? atoi(argv[2]) : 200);
+
+    // autoteste das somas compensada e exata: calc --teste-soma
+    if (argc >= 2 && strcmp(argv[1], "--teste-soma") == 0)
+        return teste_soma();
+    // benchmark das estratégias de soma: calc --bench-soma [N]
+    if (argc >= 2 && strcmp(argv[1], "--bench-soma") == 0)
+        return bench_soma(argc >= 3 ? (size_t)atol(argv[2]) : ((size_t)1 << 20));
+
+    if (argc >= 2) {
+        fprintf(stderr, "Uso: %s [--soma NOME] [OPERACAO operandos... | OPERACAO --f64|--f32|--csv arquivo | --lote [-j N] caminhos... | --bench-partida [N] | --bench-soma [N] | --teste-soma]\n", argv[0]);
+        return 2;
+    }
+
+    // loop principal do menu; o programa roda até o usuário escolher sair
+    while (1) {
+        printf("\n==== 𝖈𝖆𝖑𝖈𝖚𝖑𝖆𝖉𝖔𝖗𝖆DELUXE2.0 ====\n");
+        for (int i = 0; i < N_MENU; ++i) printf("%d) %s\n", i + 1, MENU[i].titulo);
+        printf("16) Matriz 2x2 (soma/multiplicacao)\n");
+        printf("17) Historico (listar)\n");
+        printf("18) Salvar historico em CSV (historico.csv)\n");
+        printf("19) Estrategia de soma (atual: %s)\n", nome_estrategia_soma(estrategia_soma));
+        printf("0) Sair\n");
+
+        int opc = ler_inteiro("Escolha uma opcao: ");
+
+        if (opc == 0) {
+            // antes de sair, esperamos o escritor gravar o que ainda está na fila
+            printf("Saindo...\n");
+            if (historico_encerrar(&historico)) printf("Historico salvo em '%s'\n", HIST_ARQUIVO);
+            break;
+        }
+
+        if (opc >= 1 && opc <= N_MENU) {
+            executar_item_menu(&MENU[opc - 1], &historico);
+            pausar();
+            continue;
+        }
 
+        switch (opc) {
             case 16: // operações com matrizes 2x2 (soma ou multiplicação)
             {
                 printf("1) Soma de matrizes 2x2\n2) Multiplicacao de matrizes 2x2\n");
@@ -734,34 +2375,45 @@ int main() {
                 double A[2][2], B[2][2], R[2][2];
                 ler_matriz_2x2(A, "A");
                 ler_matriz_2x2(B, "B");
-                if (t == 1) {
-                    soma_matriz_2x2(A, B, R);
-                    printf("Resultado da soma:\n"); imprimir_matriz_2x2(R);
-                    snprintf(tipo_op, sizeof(tipo_op), "MAT_SOMA");
-                } else if (t == 2) {
-                    multiplica_matriz_2x2(A, B, R);
-                    printf("Resultado da multiplicacao:\n"); imprimir_matriz_2x2(R);
-                    snprintf(tipo_op, sizeof(tipo_op), "MAT_MUL");
-                } else {
-                    printf("Opcao invalida.\n"); pausar(); break;
-                }
-                Operacao op16 = {0};
-                strcpy(op16.tipo, tipo_op);
-                op16.a = 0; op16.b = 0; op16.resultado = 0; op16.id = proximo_id++;
-                adicionar_historico(historico, &hist_count, op16);
+                if (t != 1 && t != 2) { printf("Opcao invalida.\n"); pausar(); break; }
+                const DescritorOp *d = &OPERACOES[t == 1 ? OP_MAT_SOMA : OP_MAT_MUL];
+                d->fn_matriz(A, B, R);
+                printf("%s:\n", d->rotulo); imprimir_matriz_2x2(R);
+                historico_registrar(&historico, preencher_operacao(d, NULL, 0, 0.0, 0));
                 pausar();
                 break;
             }
 
             case 17: // listar histórico
-                listar_historico(historico, hist_count);
+                historico_pronto(&historico);
+                listar_historico(historico.itens, historico.count);
+                pausar();
+                break;
+
+            case 18: // forçar a gravação do que ainda está na fila do escritor
+                historico_pronto(&historico);
+                if (historico.persist.ativo) {
+                    sincronizar_persistencia(&historico.persist);
+                    printf("Historico salvo em '%s'\n", HIST_ARQUIVO);
+                } else {
+                    printf("Erro ao abrir arquivo para salvar.\n");
+                }
                 pausar();
                 break;
 
-            case 18: // salvar histórico manualmente em CSV
-                salvar_historico_csv(historico, hist_count, "historico.csv");
+            case 19: // como média e desvio-padrão somam os elementos
+            {
+                printf("1) ingenua (laco simples)\n2) kahan (Kahan-Neumaier)\n3) pareada\n4) exata (superacumulador)\n");
+                int t = ler_inteiro("Escolha: ");
+                if (t >= 1 && t <= 4) {
+                    estrategia_soma = (EstrategiaSoma)(t - 1);
+                    printf("Estrategia de soma: %s\n", nome_estrategia_soma(estrategia_soma));
+                } else {
+                    printf("Opcao invalida.\n");
+                }
                 pausar();
                 break;
+            }
 
             default: // mensagem de invalidez
                 printf("Opa,algo deu errado ai fiote, tente de novo.\n");